@@ -59,6 +59,519 @@
 
 
 #include "QTShortCut.h"
+#if BENCHMARKING_SHORTCUTS
+#include <stdio.h>
+#include <string.h>
+#endif
+#if POSIX_SHORTCUTS
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+
+//////////
+//
+// constants
+//
+//////////
+
+// longest name of a file written through an FSSpec: 31 characters on an HFS volume, and on Windows, as many as
+// the name field of an FSSpec has always been given room for here
+#if TARGET_OS_MAC	
+#define kShortcutMaxFileNameLength	31
+#else
+#define kShortcutMaxFileNameLength	63
+#endif	// TARGET_OS_MAC	
+
+#if POSIX_SHORTCUTS
+// most files written to a POSIX folder that are kept open until the batch is flushed (see QTShortCutPendingFiles)
+#define kShortcutMaxPendingFiles	32
+#endif	// POSIX_SHORTCUTS
+
+// the four bytes of a 32-bit value, in big-endian order, for initializing byte arrays
+#define kBigEndianBytes(x)			(unsigned char)(((unsigned long)(x) >> 24) & 0xff), (unsigned char)(((unsigned long)(x) >> 16) & 0xff), \
+									(unsigned char)(((unsigned long)(x) >> 8) & 0xff), (unsigned char)((unsigned long)(x) & 0xff)
+
+
+//////////
+//
+// data types
+//
+//////////
+
+// a function that creates a single shortcut movie file
+typedef OSErr (*QTShortCutCreateProcPtr) (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr);
+
+// a function called by QTShortCut_ScanFolder for each movie file it finds; returning an error stops the scan
+typedef OSErr (*QTShortCutScanProcPtr) (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon);
+
+// a function called by a tree reader (see QTShortCut_NewTreeReader) with the data read from each file: the first
+// theDataSize bytes of a file theFileSize bytes long, unless theErr isn't noErr; returning an error stops the reader
+typedef OSErr (*QTShortCutTreeReadProcPtr) (FSSpecPtr theFSSpecPtr, Ptr theData, long theDataSize, long theFileSize, unsigned long theModDate, OSErr theErr, void *theRefCon);
+
+// the state of a call to QTShortCut_RetargetShortcuts; the two handles are reused for every file
+typedef struct {
+	QTShortCutRetargetRulePtr		fRules;
+	short							fNumRules;
+	Handle							fFileData;
+	Handle							fDataRef;
+	QTShortCutRetargetStatsPtr		fStats;
+} QTShortCutRetargetState, *QTShortCutRetargetStatePtr;
+
+// one record of a manifest read by QTShortCut_CreateShortcutsFromManifest; the pointers point into the read buffer
+typedef struct {
+	short							fKind;							// kManifestRecordOK, kManifestRecordMalformed, or kManifestRecordEmpty
+	long							fRecordSize;					// the size of the whole record, once its header has been read
+	Ptr								fName;
+	long							fNameSize;
+	OSType							fDataRefType;
+	Ptr								fDataRef;
+	long							fDataRefSize;
+} QTShortCutManifestRecord, *QTShortCutManifestRecordPtr;
+
+enum {
+	kManifestRecordOK				= 0,
+	kManifestRecordMalformed		= 1,
+	kManifestRecordEmpty			= 2							// a blank line
+};
+
+#if POSIX_SHORTCUTS
+// files written to a POSIX folder under kShortcutFlushAtEndOfBatch or kShortcutFlushPerFolder, kept open so that
+// each one can be flushed with fsync (followed by the folder) when the batch is, rather than flushing the whole system
+typedef struct {
+	short							fNumFiles;
+	int								fFiles[kShortcutMaxPendingFiles];
+	OSErr							fErr;							// the first error from flushing files early
+} QTShortCutPendingFiles, *QTShortCutPendingFilesPtr;
+#endif	// POSIX_SHORTCUTS
+
+// a folder that files are written into by name (see QTShortCut_NewOutputContext)
+struct QTShortCutOutputContext {
+	short							fVRefNum;
+	long							fDirID;
+	short							fFlushPolicy;					// the batch flush policy when the context was made
+	Boolean							fNeedsFlush;					// true if files have been written since the last flush
+#if POSIX_SHORTCUTS
+	int								fDirFD;							// the open folder, for a context made for a POSIX path; else -1
+	QTShortCutPendingFiles			fPending;						// the files written to that folder and not yet flushed
+#endif
+};
+
+// a shortcut in a reverse index (see QTShortCut_NewShortcutIndex); its data reference and file name are in the
+// index's string pool
+typedef struct {
+	OSType							fDataRefType;
+	long							fKeyOffset;						// the data reference
+	long							fKeySize;
+	long							fNameOffset;					// the file name, as a Pascal string
+	long							fParID;
+	unsigned long					fModDate;						// the file's modification date when it was read
+	short							fVRefNum;
+	Boolean							fRemoved;						// true if the record is waiting to be compacted away
+	long							fNext;							// the next record in the same hash bucket, or -1
+} QTShortCutIndexRecord, *QTShortCutIndexRecordPtr;
+
+// a reverse index from data references to the shortcut files that hold them
+struct QTShortCutIndex {
+	Handle							fPool;							// the data references and file names, back to back
+	long							fPoolSize;
+	Handle							fRecords;						// an array of QTShortCutIndexRecord
+	long							fNumRecords;
+	long							fNumRemoved;
+	Handle							fOrder;							// the record numbers, sorted by data reference, except for
+	long							fNumSorted;						//   the records added since the first fNumSorted were sorted
+	Handle							fBuckets;						// the hash table: the first record in each bucket, or -1
+	long							fNumBuckets;
+};
+
+// the steps in reading a file with asynchronous File Manager calls
+enum {
+	kAsyncReadStepOpen				= 0,
+	kAsyncReadStepRead,
+	kAsyncReadStepClose,
+	kAsyncReadStepDone
+};
+
+// one file being read by a tree reader; the data handle is reused from one file to the next
+typedef struct {
+	FSSpec							fFSSpec;
+	long							fFileSize;
+	unsigned long					fModDate;
+	Handle							fData;
+	long							fDataSize;
+	Boolean							fBusy;
+	OSErr							fErr;
+#if TARGET_OS_MAC	
+	HParamBlockRec					fParamBlock;
+	short							fStep;
+	short							fRefNum;
+#endif	// TARGET_OS_MAC	
+} QTShortCutTreeRead, *QTShortCutTreeReadPtr;
+
+// reads files found by a scan of a folder tree, with a bounded number of reads outstanding at once
+typedef struct {
+	QTShortCutTreeReadPtr			fReads;
+	short							fNumReads;
+	QTShortCutTreeReadProcPtr		fProc;
+	void *							fRefCon;
+	OSErr							fErr;							// the first error returned by fProc
+} QTShortCutTreeReader, *QTShortCutTreeReaderPtr;
+
+// the state of a call to QTShortCut_IndexShortcutFolder
+typedef struct {
+	QTShortCutIndexPtr				fIndex;
+	QTShortCutTreeReader			fReader;
+	QTShortCutIndexStatsPtr			fStats;
+} QTShortCutIndexScan, *QTShortCutIndexScanPtr;
+
+// the state of a call to QTShortCut_ValidateShortcutFolder; the alias handle is reused for every shortcut
+typedef struct {
+	QTShortCutTreeReader			fReader;
+	QTShortCutValidateProcPtr		fProc;
+	void *							fRefCon;
+	Handle							fAlias;							// NULL unless the targets of aliases are looked up
+	QTShortCutValidateStatsPtr		fStats;
+} QTShortCutValidateScan, *QTShortCutValidateScanPtr;
+
+// the files of a manifest that are waiting to be written; the handles are reused from one batch to the next
+typedef struct {
+	long							fCount;
+	Handle							fDataRefs[kShortcutManifestBatchSize];
+	OSType							fDataRefTypes[kShortcutManifestBatchSize];
+	FSSpec							fFSSpecs[kShortcutManifestBatchSize];
+	OSErr							fErrors[kShortcutManifestBatchSize];
+} QTShortCutManifestBatch, *QTShortCutManifestBatchPtr;
+
+// the sizes of the atoms in a reference movie descriptor atom (not counting the data reference itself)
+enum {
+	kRefMovieAtomHeaderSize			= 2 * kShortcutFieldSize,
+	kExtendedAtomHeaderSize			= 4 * kShortcutFieldSize,												// size 1, type, 64-bit size
+	kRefMovieDataRefAtomSize		= kRefMovieAtomHeaderSize + (3 * kShortcutFieldSize),					// flags, type, size
+	kRefMovieDataRateAtomSize		= kRefMovieAtomHeaderSize + (2 * kShortcutFieldSize),					// flags, data rate
+	kRefMovieCPURatingAtomSize		= kRefMovieAtomHeaderSize + kShortcutFieldSize + sizeof(short),			// flags, speed
+	kRefMovieVersionCheckAtomSize	= kRefMovieAtomHeaderSize + (4 * kShortcutFieldSize) + sizeof(short),	// flags, selector, values, check type
+	kRefMovieComponentCheckAtomSize	= kRefMovieAtomHeaderSize + (7 * kShortcutFieldSize),					// flags, description, version
+	kRefMovieQualityAtomSize		= kRefMovieAtomHeaderSize + kShortcutFieldSize							// quality
+};
+
+// the compiler refuses this (an array of -1 chars) unless the header of a shortcut file has the size that QuickTime
+// expects: three 8-byte atom headers and a 4-byte data reference type
+typedef char QTShortCutHeaderSizeCheck[(kShortcutHeaderSize == 28) ? 1 : -1];
+
+// flags for the checks that a reference movie choice calls for, besides data rate and CPU speed
+enum {
+	kRefMovieChoiceVersionCheck		= 1 << 0,
+	kRefMovieChoiceComponentCheck	= 1 << 1
+};
+
+// one target of a reference movie, as prepared for selection; the fields looked at for every client come first
+typedef struct {
+	long							fDataRate;
+	short							fCPUSpeed;
+	short							fChecks;
+	long							fQuality;
+	OSType							fDataRefType;
+	long							fDataRefOffset;					// from the beginning of the table
+	long							fDataRefSize;
+	OSType							fGestaltSelector;
+	long							fGestaltValue1;
+	long							fGestaltValue2;
+	short							fGestaltCheckType;
+	ComponentDescription			fComponentDesc;
+	long							fComponentMinVersion;
+} QTShortCutRefMovieChoice, *QTShortCutRefMovieChoicePtr;
+
+// the targets of a reference movie, in the order in which they should be tried, followed by their data references;
+// the whole table is a single block of memory
+struct QTShortCutRefMovieTable {
+	long							fNumChoices;
+	QTShortCutRefMovieChoice		fChoices[1];
+};
+
+// the sizes of the header and of an index entry in a shortcut pack file
+enum {
+	kShortcutPackHeaderSize			= 4 * kShortcutFieldSize,	// magic, version, count, index offset
+	kShortcutPackIndexEntrySize		= 3 * kShortcutFieldSize	// name offset, shortcut offset, shortcut size
+};
+
+// the times recorded for one step in creating shortcut files; bucket i counts the times whose value in
+// microseconds is i bits long (so bucket 0 holds times of 0, bucket 1 times of 1, bucket 2 times of 2 and 3, and so on)
+#define kShortcutNumTimeBuckets		32
+
+typedef struct {
+	unsigned long					fCount;
+	double							fTotal;
+	unsigned long					fMax;
+	unsigned long					fBuckets[kShortcutNumTimeBuckets];
+} QTShortCutPhaseHistogram;
+
+// a shortcut resolved by QTShortCut_ResolveShortcutMovieFile; the entry is valid as long as the file
+// has the same file ID and modification date as when it was read
+typedef struct {
+	Boolean							fValid;							// false if the entry is unused
+	FSSpec							fFSSpec;
+	long							fFileID;
+	unsigned long					fModDate;
+	unsigned long					fLastUsed;
+	OSType							fDataRefType;
+	Handle							fDataRef;						// kept when the entry is unused, for reuse
+} QTShortCutCacheEntry, *QTShortCutCacheEntryPtr;
+
+#if TARGET_OS_MAC	
+// the set of volumes written to during a batch that still need to be flushed, and the folder
+// that the most recent file was written to (used by the kShortcutFlushPerFolder policy)
+typedef struct {
+	short							fPolicy;
+	short							fNumVolumes;
+	short							fVolumes[kShortcutMaxBatchVolumes];
+	short							fLastVRefNum;
+	long							fLastDirID;
+} QTShortCutVolumeList, *QTShortCutVolumeListPtr;
+
+// the steps in writing a shortcut file with asynchronous File Manager calls
+enum {
+	kAsyncWriteStepDelete			= 0,
+	kAsyncWriteStepCreate,
+	kAsyncWriteStepGetInfo,
+	kAsyncWriteStepSetInfo,
+	kAsyncWriteStepOpen,
+	kAsyncWriteStepWriteHeader,
+	kAsyncWriteStepWriteDataRef,
+	kAsyncWriteStepFlushFile,
+	kAsyncWriteStepClose,
+	kAsyncWriteStepExchange,				// the remaining steps are used only when replacing files atomically
+	kAsyncWriteStepDeleteTemp,
+	kAsyncWriteStepDeleteTarget,
+	kAsyncWriteStepRename,
+	kAsyncWriteStepFlushVolume,
+	kAsyncWriteStepDone
+};
+
+// the state of a shortcut file being written with asynchronous File Manager calls;
+// all the calls share a single parameter block, so only one of them is ever outstanding
+typedef struct {
+	HParamBlockRec					fParamBlock;
+	short							fStep;
+	short							fRefNum;
+	FSSpecPtr						fFSSpecPtr;
+	Boolean							fAtomic;
+	short							fFlushPolicy;
+	FSSpec							fTempFSSpec;
+	Handle							fDataRef;
+	SignedByte						fDataRefState;
+	unsigned char					fHeader[kShortcutHeaderSize];
+	OSErr							fErr;
+} QTShortCutAsyncWrite, *QTShortCutAsyncWritePtr;
+
+// a worker thread used by QTShortCut_CreateShortcutMovieFilesInParallel; each worker owns the range
+// of items [fNext, fEnd) and steals half of another worker's remaining range when its own runs out
+typedef struct QTShortCutWorker {
+	struct QTShortCutEngine *		fEngine;
+	ThreadID						fThreadID;
+	long							fNext;
+	long							fEnd;
+	Boolean							fDone;
+	QTShortCutAsyncWrite			fWrite;
+	QTShortCutVolumeList			fVolumes;						// the volumes this worker has written to, under the batch policy
+} QTShortCutWorker, *QTShortCutWorkerPtr;
+
+// a file being written by QTShortCut_CreateShortcutMovieFilesAsync, and the index of its item in the batch
+typedef struct {
+	long							fIndex;
+	QTShortCutAsyncWrite			fWrite;
+} QTShortCutAsyncSlot, *QTShortCutAsyncSlotPtr;
+
+// the state shared by the worker threads
+typedef struct QTShortCutEngine {
+	Handle *						fDataRefs;
+	OSType *						fDataRefTypes;
+	FSSpec *						fFSSpecs;
+	OSErr *							fErrors;
+	OSErr							fErr;
+	short							fNumWorkers;
+	QTShortCutWorkerPtr				fWorkers;
+	QTShortCutVolumeList			fVolumes;						// the volumes left to flush once all the workers are done
+} QTShortCutEngine, *QTShortCutEnginePtr;
+
+// a shortcut kept in sync by a sync service (see QTShortCut_NewSyncService), and where its target was last found
+typedef struct {
+	FSSpec							fShortcut;
+	FSSpec							fTarget;
+	long							fFolder;						// the index of the target's folder in the service's folder list
+} QTShortCutSyncEntry, *QTShortCutSyncEntryPtr;
+
+// a folder holding targets of shortcuts kept in sync, as it was when it was last polled
+typedef struct {
+	short							fVRefNum;
+	long							fDirID;
+	long							fParID;							// the parent folder, name, and modification date tell
+	Str63							fName;							//   whether the folder has been renamed or moved, or
+	unsigned long					fModDate;						//   whether any file in it has
+	Boolean							fChanged;						// true while the shortcuts for a changed folder are looked at
+} QTShortCutSyncFolder, *QTShortCutSyncFolderPtr;
+
+// the reverse index kept by a sync service; the arrays are grown by doubling, and the other handles are reused
+// for every shortcut that's read
+struct QTShortCutSyncService {
+	Handle							fEntries;						// an array of QTShortCutSyncEntry
+	long							fNumEntries;
+	Handle							fFolders;						// an array of QTShortCutSyncFolder
+	long							fNumFolders;
+	long							fLastFolder;					// the folder found by the last call to QTShortCut_FindSyncFolder
+	Handle							fFileData;
+	Handle							fAlias;
+};
+#endif	// TARGET_OS_MAC	
+
+
+//////////
+//
+// global variables
+//
+//////////
+
+static QTShortCutCreateProcPtr		gCreateShortcutProc = NULL;		// how shortcut files are created; NULL until we know
+static short						gShortcutWriter = kShortcutWriterAuto;			// the writer set with QTShortCut_SetShortcutWriter
+static long							gWriteFlags = 0L;				// flags that control how shortcut files are written
+
+static unsigned short				gTempFileCount = 0;				// used to give temporary files unique names
+static short						gBatchFlushPolicy = kShortcutFlushAtEndOfBatch;	// when batches of files are flushed to disk
+static QTShortCutCacheEntry			gShortcutCache[kShortcutCacheSize];				// recently resolved shortcuts
+static unsigned long				gShortcutCacheClock = 0L;		// used to find the least recently used cache entry
+static Ptr							gScratch = NULL;				// memory reused from one file to the next (see QTShortCut_GetScratch)
+static long							gScratchSize = 0L;
+static Boolean						gInstrumenting = false;			// are we recording how long each step takes?
+static QTShortCutPhaseHistogram		gPhaseHistograms[kShortcutNumPhases];
+#if POSIX_SHORTCUTS
+#ifndef PATH_MAX
+#define PATH_MAX					1024
+#endif
+static int							gDirFD = -1;					// the folder of the last path written, kept open
+static char							gDirPath[PATH_MAX];				//   so that files written to the same folder share it
+static QTShortCutPendingFiles		gPendingFiles;					// the files written to that folder and not yet flushed
+#endif	// POSIX_SHORTCUTS
+
+// the atom headers of a shortcut file, laid out in big-endian order by the compiler: the movie atom contains the
+// movie data reference alias atom, which contains the data reference atom; the sizes and the data reference type
+// (the zeros) depend on the data reference, and are filled in by QTShortCut_FillShortcutHeader
+static const unsigned char			gShortcutHeaderTemplate[kShortcutHeaderSize] = {
+	0, 0, 0, 0,		kBigEndianBytes(MovieAID),
+	0, 0, 0, 0,		kBigEndianBytes(MovieDataRefAliasAID),
+	0, 0, 0, 0,		kBigEndianBytes(DataRefAID),
+	0, 0, 0, 0
+};
+
+
+//////////
+//
+// static function prototypes
+//
+//////////
+
+static OSErr					QTShortCut_ChooseShortcutWriter (void);
+static OSErr					QTShortCut_CreateShortcutWithToolbox (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr);
+static OSErr					QTShortCut_CreateShortcutManually (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr);
+static void						QTShortCut_FillShortcutHeader (long theDataRefSize, OSType theDataRefType, Ptr theHeader);
+static long						QTShortCut_FillExtendedShortcutHeader (UnsignedWide theDataRefSize, OSType theDataRefType, Ptr theHeader);
+static Boolean					QTShortCut_AddSize (long *theTotal, long theSize);
+static Boolean					QTShortCut_AddToWide (UnsignedWide *theWide, unsigned long theValue);
+static OSErr					QTShortCut_WriteShortcutData (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr, short theFlushPolicy);
+static OSErr					QTShortCut_WriteShortcutWithHeader (Handle theDataRef, Ptr theHeader, FSSpecPtr theFSSpecPtr, short theFlushPolicy);
+static OSErr					QTShortCut_WriteDataToFile (Ptr theBlocks[], long theSizes[], long theNumBlocks, FSSpecPtr theFSSpecPtr, short theFlushPolicy);
+static OSErr					QTShortCut_WriteDataToOpenFile (short theRefNum, Ptr theBlocks[], long theSizes[], long theNumBlocks, Boolean theTruncate, short theFlushPolicy);
+static OSErr					QTShortCut_WriteDataInContext (QTShortCutOutputContextPtr theContext, ConstStr255Param theName, Ptr theBlocks[], long theSizes[], long theNumBlocks);
+static unsigned long			QTShortCut_GetBigEndianLong (Ptr thePtr);
+static unsigned short			QTShortCut_GetBigEndianShort (Ptr thePtr);
+static Boolean					QTShortCut_GetAtomHeader (Ptr theData, long theEnd, long theOffset, long *theAtomSize, OSType *theAtomType, long *theHeaderSize);
+static long						QTShortCut_FindAtom (Ptr theData, long theStart, long theEnd, OSType theAtomType, long *theAtomSize, long *theHeaderSize);
+static Boolean					QTShortCut_ParseDescriptor (Ptr theData, long theStart, long theEnd, QTShortCutRefMovieChoicePtr theChoice);
+static Boolean					QTShortCut_IsChoiceBetter (QTShortCutRefMovieChoicePtr theChoice1, QTShortCutRefMovieChoicePtr theChoice2);
+static Boolean					QTShortCut_ClientMeetsChecks (QTShortCutRefMovieChoicePtr theChoice, QTShortCutClientInfoPtr theClient);
+static Ptr						QTShortCut_PutBigEndianLong (Ptr thePtr, unsigned long theValue);
+static Ptr						QTShortCut_PutBigEndianShort (Ptr thePtr, unsigned short theValue);
+static Ptr						QTShortCut_PutAtomHeader (Ptr thePtr, unsigned long theSize, OSType theType);
+static long						QTShortCut_GetDescriptorPrefixSize (QTShortCutRefMovieTargetPtr theTarget);
+static Ptr						QTShortCut_PutDescriptorPrefix (Ptr thePtr, QTShortCutRefMovieTargetPtr theTarget);
+static OSErr					QTShortCut_MakeTempFSSpec (FSSpecPtr theFSSpecPtr, FSSpecPtr theTempFSSpecPtr);
+static OSErr					QTShortCut_ReplaceWithTempFile (FSSpecPtr theTempFSSpecPtr, FSSpecPtr theFSSpecPtr);
+static Ptr						QTShortCut_GetScratch (long theSize);
+static OSErr					QTShortCut_GrowArray (Handle theArray, long theCount, long theItemSize);
+static OSErr					QTShortCut_GetFileStamp (FSSpecPtr theFSSpecPtr, long *theFileID, unsigned long *theModDate, long *theSize);
+static Boolean					QTShortCut_IsSameFile (FSSpecPtr theFSSpecPtr1, FSSpecPtr theFSSpecPtr2);
+static OSErr					QTShortCut_ScanFolder (short theVRefNum, long theDirID, QTShortCutScanProcPtr theProc, void *theRefCon);
+static OSErr					QTShortCut_RetargetFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon);
+static OSErr					QTShortCut_PatchDataRef (FSSpecPtr theFSSpecPtr, long theOffset, Ptr theDataRef, long theDataRefSize);
+static Boolean					QTShortCut_HasPrefix (Ptr theData, long theSize, Ptr thePrefix, long thePrefixSize);
+static unsigned long			QTShortCut_HashDataRef (Handle theDataRef, OSType theDataRefType);
+static long						QTShortCut_ParseManifestRecord (Ptr theData, long theSize, short theFormat, Boolean theAtEnd, QTShortCutManifestRecordPtr theRecord);
+static OSErr					QTShortCut_AddToManifestBatch (QTShortCutManifestBatchPtr theBatch, QTShortCutManifestRecordPtr theRecord, short theFormat, short theVRefNum, long theDirID);
+static void						QTShortCut_WriteManifestBatch (QTShortCutManifestBatchPtr theBatch, short theMaxInFlight, QTShortCutManifestStatsPtr theStats);
+static OSErr					QTShortCut_ReadManifestFile (Ptr theBuffer, long *theSize, void *theRefCon);
+static void						QTShortCut_FindDuplicates (Handle theDataRefs[], OSType theDataRefTypes[], long theCount, long theFirsts[], long theSlots[], long theNumSlots);
+static OSErr					QTShortCut_GetPackIndex (Ptr thePack, long thePackSize, long *theCount, Ptr *theIndex);
+static Boolean					QTShortCut_GetPackEntry (Ptr thePack, long thePackSize, Ptr theIndex, long theEntry, StringPtr *theName, Ptr *theShortcutPtr, long *theShortcutSize);
+static short					QTShortCut_CompareNames (ConstStr255Param theName1, ConstStr255Param theName2);
+static Boolean					QTShortCut_IsLeafName (ConstStr255Param theName);
+static void						QTShortCut_SortNames (StringPtr theNames[], long theOrder[], long theCount);
+static unsigned long			QTShortCut_StartPhase (void);
+static void						QTShortCut_EndPhase (short thePhase, unsigned long theStart);
+static OSErr					QTShortCut_IndexScanFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon);
+static OSErr					QTShortCut_IndexFileData (FSSpecPtr theFSSpecPtr, Ptr theData, long theDataSize, long theFileSize, unsigned long theModDate, OSErr theErr, void *theRefCon);
+static unsigned long			QTShortCut_HashIndexFile (FSSpecPtr theFSSpecPtr);
+static long						QTShortCut_FindIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr);
+static OSErr					QTShortCut_AddIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr, unsigned long theModDate, OSType theDataRefType, Ptr theDataRefPtr, long theDataRefSize);
+static void						QTShortCut_RemoveIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr);
+static OSErr					QTShortCut_RehashShortcutIndex (QTShortCutIndexPtr theIndex, long theNumBuckets);
+static OSErr					QTShortCut_SortShortcutIndex (QTShortCutIndexPtr theIndex);
+static OSErr					QTShortCut_CompactShortcutIndex (QTShortCutIndexPtr theIndex);
+static short					QTShortCut_CompareIndexKeys (Ptr thePool, QTShortCutIndexRecordPtr theRecord1, QTShortCutIndexRecordPtr theRecord2);
+static short					QTShortCut_CompareKeyToPrefix (Ptr theKey, long theKeySize, Ptr thePrefix, long thePrefixSize);
+static void						QTShortCut_SortIndexOrder (Ptr thePool, QTShortCutIndexRecordPtr theRecords, long theOrder[], long theCount);
+static OSErr					QTShortCut_NewTreeReader (QTShortCutTreeReaderPtr theReader, short theMaxInFlight, QTShortCutTreeReadProcPtr theProc, void *theRefCon);
+static OSErr					QTShortCut_SubmitTreeRead (QTShortCutTreeReaderPtr theReader, FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate);
+static OSErr					QTShortCut_FinishTreeReads (QTShortCutTreeReaderPtr theReader);
+static void						QTShortCut_DeliverTreeRead (QTShortCutTreeReaderPtr theReader, QTShortCutTreeReadPtr theRead);
+static void						QTShortCut_DisposeTreeReader (QTShortCutTreeReaderPtr theReader);
+static Boolean					QTShortCut_ContinueTreeRead (QTShortCutTreeReadPtr theRead);
+static OSErr					QTShortCut_ValidateScanFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon);
+static OSErr					QTShortCut_ValidateFileData (FSSpecPtr theFSSpecPtr, Ptr theData, long theDataSize, long theFileSize, unsigned long theModDate, OSErr theErr, void *theRefCon);
+static short					QTShortCut_CheckShortcutData (Ptr theData, long theDataSize, long theFileSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize);
+#if POSIX_SHORTCUTS
+static OSErr					QTShortCut_WriteShortcutDataToPath (Handle theDataRef, OSType theDataRefType, const char *thePath, short theFlushPolicy);
+static OSErr					QTShortCut_WriteDataToPath (Ptr theBlocks[], long theSizes[], long theNumBlocks, const char *thePath, short theFlushPolicy);
+static OSErr					QTShortCut_WriteDataAt (int theDirFD, const char *theName, Ptr theBlocks[], long theSizes[], long theNumBlocks, short theFlushPolicy, QTShortCutPendingFilesPtr thePending);
+static OSErr					QTShortCut_FlushPendingFiles (QTShortCutPendingFilesPtr thePending, int theDirFD);
+static OSErr					QTShortCut_OpenPathFolder (const char *thePath, const char **theName, Boolean *theChanged);
+static OSErr					QTShortCut_GetErrnoError (int theErrno);
+#endif	// POSIX_SHORTCUTS
+#if BENCHMARKING_SHORTCUTS
+static OSErr					QTShortCut_BenchmarkWrites (char *theVolumeName, FSSpec theFSSpecs[], Handle theDataRefs[], OSType theDataRefTypes[], OSErr theErrors[], long theCount, long theSize, Handle theResults);
+static OSErr					QTShortCut_AddBenchmarkResult (Handle theResults, char *theName, char *theVolumeName, long theSize, short theNumThreads, long theCount, double theMicroseconds);
+static double					QTShortCut_GetMicroseconds (void);
+#endif
+#if TARGET_OS_MAC	
+static void						QTShortCut_InitVolumeList (QTShortCutVolumeListPtr theVolumes, short thePolicy);
+static OSErr					QTShortCut_RememberFile (QTShortCutVolumeListPtr theVolumes, FSSpecPtr theFSSpecPtr);
+static OSErr					QTShortCut_RememberVolume (QTShortCutVolumeListPtr theVolumes, short theVRefNum);
+static OSErr					QTShortCut_FlushVolumes (QTShortCutVolumeListPtr theVolumes);
+static void						QTShortCut_StartAsyncWrite (QTShortCutAsyncWritePtr theWrite, Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr, short theFlushPolicy);
+static Boolean					QTShortCut_ContinueAsyncWrite (QTShortCutAsyncWritePtr theWrite);
+static void						QTShortCut_IssueAsyncDelete (QTShortCutAsyncWritePtr theWrite, FSSpecPtr theFSSpecPtr);
+static void						QTShortCut_IssueAsyncRename (QTShortCutAsyncWritePtr theWrite);
+static Boolean					QTShortCut_GetNextWorkItem (QTShortCutWorkerPtr theWorker, long *theIndex);
+static pascal voidPtr			QTShortCut_WorkerThread (void *theParam);
+static void						QTShortCut_StartTreeRead (QTShortCutTreeReadPtr theRead);
+static OSErr					QTShortCut_IndexSyncShortcut (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon);
+static OSErr					QTShortCut_ReadSyncAlias (QTShortCutSyncServicePtr theService, FSSpecPtr theFSSpecPtr, Boolean *theIsAlias);
+static OSErr					QTShortCut_SyncShortcut (QTShortCutSyncServicePtr theService, long theIndex, QTShortCutSyncStatsPtr theStats, QTShortCutVolumeListPtr theVolumes, Boolean *theDropped);
+static OSErr					QTShortCut_AddSyncEntry (QTShortCutSyncServicePtr theService, FSSpecPtr theShortcut, FSSpecPtr theTarget, Boolean theMayExist);
+static OSErr					QTShortCut_FindSyncFolder (QTShortCutSyncServicePtr theService, short theVRefNum, long theDirID, long *theFolder);
+static void						QTShortCut_GetSyncFolderState (short theVRefNum, long theDirID, QTShortCutSyncFolderPtr theFolder);
+static OSErr					QTShortCut_CheckAliasTarget (FSSpecPtr theFSSpecPtr, Handle theAlias, Ptr theDataRefPtr, long theDataRefSize);
+#endif	// TARGET_OS_MAC	
 
 
 //////////
@@ -70,161 +583,6656 @@
 
 OSErr QTShortCut_CreateShortcutMovieFile (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr)
 {
-	long	 	myVersion = 0L;
 	OSErr		myErr = noErr;
 	
-	myErr = Gestalt(gestaltQuickTime, &myVersion);
-	if (myErr != noErr)
-		goto bail;
+	// the QuickTime version is checked only the first time through (see QTShortCut_SetShortcutWriter);
+	// after that, we go straight to the function that does the work
+	if (gCreateShortcutProc == NULL) {
+		myErr = QTShortCut_ChooseShortcutWriter();
+		if (myErr != noErr)
+			return(myErr);
+	}
+	
+	return((*gCreateShortcutProc)(theDataRef, theDataRefType, theFSSpecPtr));
+}
 
-	if (((myVersion >> 16) & 0xffff) >= 0x0400) {
-		// we're running under QuickTime 4.0 or greater; we can use the function CreateShortcutMovieFile
 
-		myErr = CreateShortcutMovieFile(theFSSpecPtr,
-										kShortcutFileCreator,
-								 		smCurrentScript,
-										createMovieFileDeleteCurFile | createMovieFileDontCreateResFile,
-										theDataRef,
-										theDataRefType);
-										
-	} else {
-		// we're running under a version of QuickTime prior to 4.0; do the grunt work ourselves
-		
-		OSType							myDataRefType;
-		unsigned long					myAtomHeaderSize;		
-		Ptr								myData = NULL;
-		Handle							myMoovAtom = NULL;
-
-		//////////
-		//
-		// create the atom data that goes into a data reference atom (we will create this atom's
-		// header when we create the movie atom that contains it); the atom data is the data reference
-		// type followed by the data reference itself
-		//
-		//////////
-
-		myDataRefType = EndianU32_NtoB(theDataRefType);
-		myAtomHeaderSize = 2 * sizeof(long);		
-
-		// allocate a data block and copy the data reference type and data reference into it
-		myData = NewPtrClear(sizeof(OSType) + GetHandleSize(theDataRef));
-		if (myData == NULL)
-			goto bail;
-				
-		BlockMove(&myDataRefType, myData, sizeof(OSType));
-		BlockMove(*theDataRef, (Ptr)(myData + sizeof(OSType)), GetHandleSize(theDataRef));
-
-		//////////
-		//
-		// create a handle to contain the size and type fields of the movie atom, as well as
-		// the size and type fields of the movie data reference alias atom contained in it
-		// and of the data reference atom contained in the movie data reference alias atom
-		//
-		//////////
-		
-		myMoovAtom = NewHandleClear(3 * myAtomHeaderSize);
-		if (myMoovAtom == NULL)
-			goto bail;
-		
-		// fill in the size and type fields of the three atoms
-		*((long *)(*myMoovAtom + 0x00)) = EndianU32_NtoB((3 * myAtomHeaderSize) + GetPtrSize(myData));
-		*((long *)(*myMoovAtom + 0x04)) = EndianU32_NtoB(MovieAID);
-		*((long *)(*myMoovAtom + 0x08)) = EndianU32_NtoB((2 * myAtomHeaderSize) + GetPtrSize(myData));
-		*((long *)(*myMoovAtom + 0x0C)) = EndianU32_NtoB(MovieDataRefAliasAID);
-		*((long *)(*myMoovAtom + 0x10)) = EndianU32_NtoB((1 * myAtomHeaderSize) + GetPtrSize(myData));
-		*((long *)(*myMoovAtom + 0x14)) = EndianU32_NtoB(DataRefAID);
+//////////
+//
+// QTShortCut_CreateShortcutMovieFiles
+// Create a batch of shortcut movie files; the i-th file is specified by theFSSpecs[i] and is a shortcut
+// to the data reference theDataRefs[i], of type theDataRefTypes[i].
+//
+// This is equivalent to calling QTShortCut_CreateShortcutMovieFile once for each file, but the QuickTime
+// version is checked only once, and the files are flushed to disk according to the current batch flush policy
+// (see QTShortCut_SetBatchFlushPolicy); by default, each volume touched by the batch is flushed only once,
+// after all the files have been written.
+//
+// A failure on one file does not stop the batch; if theErrors is not NULL, theErrors[i] receives the result
+// for the i-th file. The function result is noErr if every file was created, or else the first error encountered.
+//
+// If the kShortcutWriteDedupTargets write flag is set, the batch is first searched for files that have the same
+// target (the same data reference type and the same bytes of data reference) as an earlier file. Only the first
+// file with each target goes through the shortcut writer; the others are written straight from the header that
+// was assembled for that file, which spares building the header again, or a call to CreateShortcutMovieFile when
+// the Toolbox writer was chosen automatically. If the Toolbox writer was set with QTShortCut_SetShortcutWriter,
+// the flag is ignored and every file goes through CreateShortcutMovieFile. (HFS has no hard links, so each
+// duplicate is still a file of its own.)
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutMovieFiles (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, OSErr theErrors[])
+{
+	Boolean		myUseToolbox = false;
+#if TARGET_OS_MAC	
+	QTShortCutVolumeList	myVolumes;
+#endif	// TARGET_OS_MAC	
+	long		*myFirsts = NULL;
+	long		myNumSlots = 1L;
+	char		*myHeaders = NULL;
+	long		myIndex;
+	OSErr		myItemErr = noErr;
+	OSErr		myErr = noErr;
+	
+	if ((theDataRefs == NULL) || (theDataRefTypes == NULL) || (theFSSpecs == NULL) || (theCount < 0))
+		return(paramErr);
 
-		// concatenate the data in myData onto the end of the movie atom
-		myErr = PtrAndHand(myData, myMoovAtom, GetPtrSize(myData));
+	if (gCreateShortcutProc == NULL) {
+		myErr = QTShortCut_ChooseShortcutWriter();
 		if (myErr != noErr)
 			goto bail;
+	}
+
+	myUseToolbox = (gCreateShortcutProc == QTShortCut_CreateShortcutWithToolbox);
+	
+	// find the first file with each target; the hash table's slots are kept at most half full, and are
+	// followed by room for the header of each file
+	if ((gWriteFlags & kShortcutWriteDedupTargets) && (theCount > 1) && (gShortcutWriter != kShortcutWriterToolbox)) {
+		while (myNumSlots < 2 * theCount)
+			myNumSlots <<= 1;
+		
+		myFirsts = (long *)QTShortCut_GetScratch(((theCount + myNumSlots) * sizeof(long)) + (theCount * kShortcutHeaderSize));
+		if (myFirsts != NULL) {
+			QTShortCut_FindDuplicates(theDataRefs, theDataRefTypes, theCount, myFirsts, myFirsts + theCount, myNumSlots);
+			myHeaders = (char *)(myFirsts + theCount + myNumSlots);
+		}
+	}
+	
+#if TARGET_OS_MAC	
+	QTShortCut_InitVolumeList(&myVolumes, gBatchFlushPolicy);
+#endif	// TARGET_OS_MAC	
 
-		//////////
-		//
-		// create the shortcut movie file
-		//
-		//////////
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		FSSpecPtr	myFSSpecPtr = &theFSSpecs[myIndex];
+		long		myFirst = (myFirsts != NULL) ? myFirsts[myIndex] : myIndex;
+		Ptr			myHeader = NULL;
 		
-		myErr = QTShortCut_WriteHandleToFile(myMoovAtom, theFSSpecPtr);
+		if (myHeaders != NULL) {
+			myHeader = (Ptr)(myHeaders + (myFirst * kShortcutHeaderSize));
+			
+			// the first file with each target assembles the header that the files after it reuse
+			if ((myFirst == myIndex) && (theDataRefs[myIndex] != NULL)) {
+				unsigned long	myStart = QTShortCut_StartPhase();
+				
+				QTShortCut_FillShortcutHeader(GetHandleSize(theDataRefs[myIndex]), theDataRefTypes[myIndex], myHeader);
+				QTShortCut_EndPhase(kShortcutPhaseAssemble, myStart);
+			}
+		}
 		
-bail:
-		if (myData != NULL)	
-			DisposePtr(myData);
+		if ((myFirst != myIndex) && (myFirsts[myFirst] == myFirst)) {
+			// the same target as an earlier file that was written successfully
+			myItemErr = QTShortCut_WriteShortcutWithHeader(theDataRefs[myFirst], myHeader, myFSSpecPtr, gBatchFlushPolicy);
+		} else if (myUseToolbox) {
+			myItemErr = QTShortCut_CreateShortcutWithToolbox(theDataRefs[myIndex], theDataRefTypes[myIndex], myFSSpecPtr);
+
+#if TARGET_OS_MAC	
+			// we don't have access to the file that CreateShortcutMovieFile wrote, so we flush the whole volume
+			if ((myItemErr == noErr) && (gBatchFlushPolicy >= kShortcutFlushPerFile))
+				myItemErr = FlushVol(NULL, myFSSpecPtr->vRefNum);
+#endif	// TARGET_OS_MAC	
+		} else if (myHeader != NULL) {
+			myItemErr = QTShortCut_WriteShortcutWithHeader(theDataRefs[myIndex], myHeader, myFSSpecPtr, gBatchFlushPolicy);
+		} else {
+			myItemErr = QTShortCut_WriteShortcutData(theDataRefs[myIndex], theDataRefTypes[myIndex], myFSSpecPtr, gBatchFlushPolicy);
+		}
 
-		if (myMoovAtom != NULL)
-			DisposeHandle(myMoovAtom);
+#if TARGET_OS_MAC	
+		// remember the file's volume and folder, so that we can flush them when the batch policy says so
+		if (myItemErr == noErr)
+			myItemErr = QTShortCut_RememberFile(&myVolumes, myFSSpecPtr);
+#endif	// TARGET_OS_MAC	
+		
+		// if the first file with this target failed, don't treat the files after it as copies of it
+		if ((myFirsts != NULL) && (myFirst == myIndex) && (myItemErr != noErr))
+			myFirsts[myIndex] = -1L;
+		
+		if (theErrors != NULL)
+			theErrors[myIndex] = myItemErr;
+			
+		if ((myErr == noErr) && (myItemErr != noErr))
+			myErr = myItemErr;
 	}
 
+#if TARGET_OS_MAC	
+	// flush each volume that we wrote to and haven't flushed yet
+	myItemErr = QTShortCut_FlushVolumes(&myVolumes);
+	if (myErr == noErr)
+		myErr = myItemErr;
+#endif	// TARGET_OS_MAC	
+
+bail:
 	return(myErr);
 }
 
 
 //////////
 //
-// QTShortCut_WriteHandleToFile
-// Write the data in the specified handle into the specified file;
-// if the file already exists, it is overwritten.
+// QTShortCut_CreateShortcutMovieFilesInParallel
+// Create a batch of shortcut movie files, as QTShortCut_CreateShortcutMovieFiles does, but using theNumWorkers
+// worker threads, so that several files are being written at any one time.
+//
+// Each worker is a cooperative thread that writes one file at a time using asynchronous File Manager calls,
+// yielding to the other threads while each call is in progress; this keeps up to theNumWorkers requests
+// outstanding with the file system. The batch is split evenly among the workers, and a worker that finishes
+// its share early takes over half of the remaining share of the busiest worker. The files are flushed to disk
+// according to the current batch flush policy; under kShortcutFlushPerFolder, a volume is flushed when one worker
+// moves on to a different folder, regardless of the folders the other workers are writing to.
+//
+// The shortcut files are always assembled by hand, in the same format that CreateShortcutMovieFile uses. If the
+// Thread Manager is not available (or on Windows), this function simply calls QTShortCut_CreateShortcutMovieFiles.
 //
 //////////
 
-OSErr QTShortCut_WriteHandleToFile (Handle theHandle, FSSpecPtr theFSSpecPtr)
+OSErr QTShortCut_CreateShortcutMovieFilesInParallel (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, short theNumWorkers, OSErr theErrors[])
 {
-	short			myRefNum = 0;
-	short			myVolNum;
-	long			mySize = 0;
-	OSErr			myErr = paramErr;
-
-	if (theHandle == NULL)
-		goto bail;
+#if TARGET_OS_MAC	
+	QTShortCutEngine		myEngine;
+	QTShortCutWorkerPtr		myWorker;
+	ThreadEntryUPP			myThreadUPP = NULL;
+	long					myAttributes = 0L;
+	long					myShare;
+	short					myIndex;
+	Boolean					myAllDone;
+	OSErr					myErr = noErr;
+	
+	if ((theDataRefs == NULL) || (theDataRefTypes == NULL) || (theFSSpecs == NULL) || (theCount < 0))
+		return(paramErr);
 
-	mySize = GetHandleSize(theHandle);
-	if (mySize == 0)
-		goto bail;
+	if ((Gestalt(gestaltThreadMgrAttr, &myAttributes) != noErr) || ((myAttributes & (1L << gestaltThreadMgrPresent)) == 0))
+		return(QTShortCut_CreateShortcutMovieFiles(theDataRefs, theDataRefTypes, theFSSpecs, theCount, theErrors));
+	
+	if (theCount == 0)
+		return(noErr);
 
-	HLock(theHandle);
+	// there's no point in having more workers than files
+	if (theNumWorkers > theCount)
+		theNumWorkers = (short)theCount;
+	if (theNumWorkers > kShortcutMaxWorkers)
+		theNumWorkers = kShortcutMaxWorkers;
+	if (theNumWorkers < 1)
+		theNumWorkers = 1;
 	
-	// delete the file;
-	// if it doesn't exist yet, we'll get an error (fnfErr), which we just ignore
-	myErr = FSpDelete(theFSSpecPtr);
+	myEngine.fDataRefs = theDataRefs;
+	myEngine.fDataRefTypes = theDataRefTypes;
+	myEngine.fFSSpecs = theFSSpecs;
+	myEngine.fErrors = theErrors;
+	myEngine.fErr = noErr;
+	myEngine.fNumWorkers = theNumWorkers;
+	QTShortCut_InitVolumeList(&myEngine.fVolumes, kShortcutFlushAtEndOfBatch);
 	
-	// create and open the file
-	myErr = FSpCreate(theFSSpecPtr, kShortcutFileCreator, kShortcutFileType, smSystemScript);
+	myEngine.fWorkers = (QTShortCutWorkerPtr)NewPtrClear(theNumWorkers * sizeof(QTShortCutWorker));
+	if (myEngine.fWorkers == NULL)
+		return(MemError());
+	
+	myThreadUPP = NewThreadEntryProc(QTShortCut_WorkerThread);
 
-	if (myErr == noErr)
-		myErr = FSpOpenDF(theFSSpecPtr, fsRdWrPerm, &myRefNum);
+	// give each worker an equal share of the batch and start it running
+	myShare = theCount / theNumWorkers;
+	for (myIndex = 0; myIndex < theNumWorkers; myIndex++) {
+		myWorker = &myEngine.fWorkers[myIndex];
+		myWorker->fEngine = &myEngine;
+		myWorker->fNext = myIndex * myShare;
+		myWorker->fEnd = (myIndex == theNumWorkers - 1) ? theCount : myWorker->fNext + myShare;
+		myWorker->fDone = false;
+		QTShortCut_InitVolumeList(&myWorker->fVolumes, gBatchFlushPolicy);
+		
+		myErr = NewThread(kCooperativeThread, myThreadUPP, myWorker, 0, kCreateIfNeeded, NULL, &myWorker->fThreadID);
+		if (myErr != noErr) {
+			// this worker's share gets stolen by the workers that are already running
+			myWorker->fDone = true;
+			if (myIndex == 0)
+				goto bail;
+			myErr = noErr;
+		}
+	}
 	
-	// position the file mark to the beginning of the file and write the data
-	if (myErr == noErr)
-		myErr = SetFPos(myRefNum, fsFromStart, 0);
+	// let the workers run until they have all finished
+	do {
+		YieldToAnyThread();
+		
+		myAllDone = true;
+		for (myIndex = 0; myIndex < theNumWorkers; myIndex++)
+			if (!myEngine.fWorkers[myIndex].fDone)
+				myAllDone = false;
+	} while (!myAllDone);
+	
+	// flush each volume that we wrote to and haven't flushed yet; each worker keeps its own list (so that under
+	// kShortcutFlushPerFolder, one worker moving to another folder doesn't flush the folders of the others),
+	// and the lists are merged here so that a volume shared by several workers is flushed only once
+	for (myIndex = 0; myIndex < theNumWorkers; myIndex++) {
+		QTShortCutVolumeListPtr		myVolumes = &myEngine.fWorkers[myIndex].fVolumes;
+		short						myVolume;
+		
+		for (myVolume = 0; myVolume < myVolumes->fNumVolumes; myVolume++) {
+			myErr = QTShortCut_RememberVolume(&myEngine.fVolumes, myVolumes->fVolumes[myVolume]);
+			if ((myEngine.fErr == noErr) && (myErr != noErr))
+				myEngine.fErr = myErr;
+		}
+	}
+	
+	myErr = QTShortCut_FlushVolumes(&myEngine.fVolumes);
+	if (myEngine.fErr != noErr)
+		myErr = myEngine.fErr;
 
-	if (myErr == noErr)
-		myErr = FSWrite(myRefNum, &mySize, *theHandle);
+bail:
+	if (myThreadUPP != NULL)
+		DisposeRoutineDescriptor((UniversalProcPtr)myThreadUPP);
 
-	if (myErr == noErr)
-		myErr = SetFPos(myRefNum, fsFromStart, mySize);
+	DisposePtr((Ptr)myEngine.fWorkers);
 
-	// resize the file to the number of bytes written
-	if (myErr == noErr)
-		myErr = SetEOF(myRefNum, mySize);
-				
-	// close the file			 
-	if (myErr == noErr)		
-		myErr = FSClose(myRefNum);
+	return(myErr);
+#else
+	return(QTShortCut_CreateShortcutMovieFiles(theDataRefs, theDataRefTypes, theFSSpecs, theCount, theErrors));
+#endif	// TARGET_OS_MAC	
+}
 
-#if TARGET_OS_MAC	
-	// flush the volume
-	if (myErr == noErr)		
-		myErr = GetVRefNum(myRefNum, &myVolNum);
 
-	if (myErr == noErr)		
-		myErr = FlushVol(NULL, myVolNum);
+//////////
+//
+// QTShortCut_CreateShortcutMovieFilesAsync
+// Create a batch of shortcut movie files, as QTShortCut_CreateShortcutMovieFiles does, but from a single thread
+// that keeps up to theMaxInFlight files being written at any one time.
+//
+// Each file is written with the same chain of asynchronous File Manager calls that the workers used by
+// QTShortCut_CreateShortcutMovieFilesInParallel issue (delete, create, set type and creator, open, write, close),
+// but instead of a thread per file there is just a fixed set of slots: as soon as the chain for one file completes,
+// the slot it occupied is given the next file in the batch. No more than theMaxInFlight chains (and so no more than
+// theMaxInFlight File Manager requests) are ever queued, and nothing is allocated per file. The files are flushed
+// to disk according to the current batch flush policy.
+//
+// The shortcut files are always assembled by hand. On Windows, this function simply calls QTShortCut_CreateShortcutMovieFiles.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutMovieFilesAsync (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, short theMaxInFlight, OSErr theErrors[])
+{
+#if TARGET_OS_MAC	
+	QTShortCutAsyncSlotPtr	mySlots = NULL;
+	QTShortCutAsyncSlotPtr	mySlot;
+	QTShortCutVolumeList	myVolumes;
+	long					myNext = 0L;
+	short					myNumInFlight = 0;
+	short					myIndex;
+	OSErr					myItemErr = noErr;
+	OSErr					myErr = noErr;
+	
+	if ((theDataRefs == NULL) || (theDataRefTypes == NULL) || (theFSSpecs == NULL) || (theCount < 0))
+		return(paramErr);
+	
+	if (theCount == 0)
+		return(noErr);
+	
+	if (theMaxInFlight > theCount)
+		theMaxInFlight = (short)theCount;
+	if (theMaxInFlight > kShortcutMaxWritesInFlight)
+		theMaxInFlight = kShortcutMaxWritesInFlight;
+	if (theMaxInFlight < 1)
+		theMaxInFlight = 1;
+	
+	mySlots = (QTShortCutAsyncSlotPtr)NewPtrClear(theMaxInFlight * sizeof(QTShortCutAsyncSlot));
+	if (mySlots == NULL)
+		return(MemError());
+	
+	QTShortCut_InitVolumeList(&myVolumes, gBatchFlushPolicy);
+	
+	// start as many files as we're allowed to
+	for (myIndex = 0; myIndex < theMaxInFlight; myIndex++) {
+		mySlot = &mySlots[myIndex];
+		mySlot->fIndex = myNext++;
+		QTShortCut_StartAsyncWrite(&mySlot->fWrite, theDataRefs[mySlot->fIndex], theDataRefTypes[mySlot->fIndex], &theFSSpecs[mySlot->fIndex], gBatchFlushPolicy);
+		myNumInFlight++;
+	}
+	
+	// keep looking for chains that have moved on or finished; refill each slot as soon as it's free
+	while (myNumInFlight > 0) {
+		for (myIndex = 0; myIndex < theMaxInFlight; myIndex++) {
+			mySlot = &mySlots[myIndex];
+			if (mySlot->fIndex < 0)
+				continue;
+			
+			if (!QTShortCut_ContinueAsyncWrite(&mySlot->fWrite))
+				continue;
+			
+			myItemErr = mySlot->fWrite.fErr;
+			if (myItemErr == noErr)
+				myItemErr = QTShortCut_RememberFile(&myVolumes, &theFSSpecs[mySlot->fIndex]);
+			
+			if (theErrors != NULL)
+				theErrors[mySlot->fIndex] = myItemErr;
+			
+			if ((myErr == noErr) && (myItemErr != noErr))
+				myErr = myItemErr;
+			
+			if (myNext < theCount) {
+				mySlot->fIndex = myNext++;
+				QTShortCut_StartAsyncWrite(&mySlot->fWrite, theDataRefs[mySlot->fIndex], theDataRefTypes[mySlot->fIndex], &theFSSpecs[mySlot->fIndex], gBatchFlushPolicy);
+			} else {
+				mySlot->fIndex = -1;
+				myNumInFlight--;
+			}
+		}
+	}
+	
+	// flush each volume that we wrote to and haven't flushed yet
+	myItemErr = QTShortCut_FlushVolumes(&myVolumes);
+	if (myErr == noErr)
+		myErr = myItemErr;
+	
+	DisposePtr((Ptr)mySlots);
+	
+	return(myErr);
+#else
+	return(QTShortCut_CreateShortcutMovieFiles(theDataRefs, theDataRefTypes, theFSSpecs, theCount, theErrors));
 #endif	// TARGET_OS_MAC	
+}
 
-bail:
-	HUnlock(theHandle);
 
+//////////
+//
+// QTShortCut_CreateShortcutMovieFileFromStream
+// Create a shortcut movie file whose data reference, theDataRefSize bytes long, is supplied piece by piece by
+// theReadProc; the data reference is copied into the file through a small buffer, so it never needs to be in
+// memory all at once. This is meant for data references too large to be held in a handle, such as a handle data
+// reference that contains a whole movie.
+//
+// theDataRefSize is a 64-bit size. If the atoms that contain the data reference are too large for 32-bit sizes,
+// they're given extended sizes (a size of 1, followed by the type and then the 64-bit size); otherwise, the file is
+// exactly what QTShortCut_CreateShortcutMovieFile would write. The sizes are checked as they're added up, so a size
+// too large for the atom format is reported (as paramErr) rather than wrapping around. Whether the volume can hold
+// a file that large is up to the File Manager.
+//
+// If theReadProc runs out of data before theDataRefSize bytes, the file is deleted and eofErr is returned.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutMovieFileFromStream (QTShortCutReadProcPtr theReadProc, void *theRefCon, UnsignedWide theDataRefSize, OSType theDataRefType, FSSpecPtr theFSSpecPtr)
+{
+	FSSpec			myTempFSSpec;
+	FSSpecPtr		myFSSpecPtr = theFSSpecPtr;
+	Boolean			myAtomic = ((gWriteFlags & kShortcutWriteAtomicReplace) != 0);
+	unsigned char	myHeader[kShortcutExtendedHeaderSize];
+	UnsignedWide	myRemaining = theDataRefSize;
+	Ptr				myBuffer;
+	Boolean			myCreated = false;
+	short			myRefNum = 0;
+	long			mySize;
+	OSErr			myReadErr = noErr;
+	OSErr			myErr = noErr;
+	
+	if ((theReadProc == NULL) || (theFSSpecPtr == NULL))
+		return(paramErr);
+	
+	mySize = QTShortCut_FillExtendedShortcutHeader(theDataRefSize, theDataRefType, (Ptr)myHeader);
+	if (mySize == 0)
+		return(paramErr);
+	
+	myBuffer = QTShortCut_GetScratch(kShortcutStreamBufferSize);
+	if (myBuffer == NULL)
+		return(memFullErr);
+	
+	// the file is always written from scratch, so it never needs to be truncated (which would take a 32-bit size)
+	if (myAtomic) {
+		myErr = QTShortCut_MakeTempFSSpec(theFSSpecPtr, &myTempFSSpec);
+		if (myErr != noErr)
+			return(myErr);
+		myFSSpecPtr = &myTempFSSpec;
+	}
+	
+	FSpDelete(myFSSpecPtr);
+	
+	myErr = FSpCreate(myFSSpecPtr, kShortcutFileCreator, kShortcutFileType, smSystemScript);
+	myCreated = (myErr == noErr);
+	if (myErr == noErr)
+		myErr = FSpOpenDF(myFSSpecPtr, fsRdWrPerm, &myRefNum);
+	
+	if (myErr == noErr)
+		myErr = FSWrite(myRefNum, &mySize, (Ptr)myHeader);
+	
+	// copy the data reference, a buffer at a time
+	while ((myErr == noErr) && ((myRemaining.hi != 0) || (myRemaining.lo != 0))) {
+		mySize = ((myRemaining.hi != 0) || (myRemaining.lo > kShortcutStreamBufferSize)) ? kShortcutStreamBufferSize : (long)myRemaining.lo;
+		
+		myReadErr = (*theReadProc)(myBuffer, &mySize, theRefCon);
+		if ((myReadErr != noErr) && (myReadErr != eofErr)) {
+			myErr = myReadErr;
+			break;
+		}
+		
+		if (mySize == 0) {
+			myErr = eofErr;
+			break;
+		}
+		
+		if (myRemaining.lo < (unsigned long)mySize)
+			myRemaining.hi--;
+		myRemaining.lo -= mySize;
+		
+		myErr = FSWrite(myRefNum, &mySize, myBuffer);
+		
+		if ((myErr == noErr) && (myReadErr == eofErr) && ((myRemaining.hi != 0) || (myRemaining.lo != 0)))
+			myErr = eofErr;
+	}
+	
+	if (myRefNum != 0) {
+		if (myErr == noErr)
+			myErr = FSClose(myRefNum);
+		else
+			FSClose(myRefNum);
+	}
+	
+	// a partial shortcut is worse than none; if we were replacing the file atomically, the old one is left alone
+	if (myErr == noErr) {
+		if (myAtomic)
+			myErr = QTShortCut_ReplaceWithTempFile(myFSSpecPtr, theFSSpecPtr);
+	} else if (myCreated) {
+		FSpDelete(myFSSpecPtr);
+	}
+	
+	QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+	
+#if TARGET_OS_MAC	
+	if (myErr == noErr)
+		myErr = FlushVol(NULL, theFSSpecPtr->vRefNum);
+#endif	// TARGET_OS_MAC	
+	
 	return(myErr);
 }
 
 
+//////////
+//
+// QTShortCut_CreateReferenceMovieFile
+// Create a reference movie file that refers to the specified targets; when the movie is opened, QuickTime picks
+// the best target whose conditions (data rate, CPU speed, version and component checks) are met.
+//
+// The file consists of a movie atom containing a single reference movie record atom, which contains one reference
+// movie descriptor atom for each target:
+//
+//					movie atom -> reference movie record atom => reference movie descriptor atoms
+//
+// (where "=>" means: "contains one or more"). Each descriptor atom holds the target's qualifier atoms, followed by
+// its data reference atom. All the sizes are worked out before anything is written, the atom headers and qualifiers
+// for the whole movie are assembled in a single block of memory, and the data references are written straight from
+// the specified handles, just as QTShortCut_CreateShortcutMovieFile does for the pre-4.0 case.
+//
+//////////
+
+OSErr QTShortCut_CreateReferenceMovieFile (QTShortCutRefMovieTarget theTargets[], short theNumTargets, FSSpecPtr theFSSpecPtr)
+{
+	Ptr					myBuffer = NULL;
+	Ptr *				myBlocks;
+	long *				mySizes;
+	SignedByte *		myStates;
+	Ptr					myPtr;
+	Ptr					myStart;
+	long				myPrefixSize = 0L;
+	long				myDataSize = 0L;
+	long				myTotalSize = 2 * kRefMovieAtomHeaderSize;
+	long				mySize;
+	long				myBufferSize;
+	short				myIndex;
+	OSErr				myErr = noErr;
+	
+	if ((theTargets == NULL) || (theNumTargets <= 0) || (theFSSpecPtr == NULL))
+		return(paramErr);
+	
+	// work out the total size of the atom headers and qualifiers, and of the data references;
+	// the whole movie atom must fit in a file the File Manager can write
+	for (myIndex = 0; myIndex < theNumTargets; myIndex++) {
+		if (theTargets[myIndex].fDataRef == NULL)
+			return(paramErr);
+		
+		mySize = QTShortCut_GetDescriptorPrefixSize(&theTargets[myIndex]);
+		if (!QTShortCut_AddSize(&myTotalSize, mySize) || !QTShortCut_AddSize(&myTotalSize, GetHandleSize(theTargets[myIndex].fDataRef)))
+			return(paramErr);
+		
+		myPrefixSize += mySize;
+		myDataSize += GetHandleSize(theTargets[myIndex].fDataRef);
+	}
+	
+	// get room for the atom headers, the list of blocks to write, and the saved handle states all at once
+	myBufferSize = (2 * kRefMovieAtomHeaderSize) + myPrefixSize + (2 * theNumTargets * (sizeof(Ptr) + sizeof(long))) + theNumTargets;
+	myBuffer = QTShortCut_GetScratch(myBufferSize);
+	if (myBuffer == NULL)
+		return(memFullErr);
+	
+	myBlocks = (Ptr *)myBuffer;
+	mySizes = (long *)(myBlocks + (2 * theNumTargets));
+	myStates = (SignedByte *)(mySizes + (2 * theNumTargets));
+	myPtr = (Ptr)(myStates + theNumTargets);
+	
+	// the movie atom and the reference movie record atom just contain everything else
+	myStart = myPtr;
+	myPtr = QTShortCut_PutAtomHeader(myPtr, (2 * kRefMovieAtomHeaderSize) + myPrefixSize + myDataSize, MovieAID);
+	myPtr = QTShortCut_PutAtomHeader(myPtr, kRefMovieAtomHeaderSize + myPrefixSize + myDataSize, ReferenceMovieRecordAID);
+	
+	// each target contributes two blocks: its atom headers and qualifiers, and its data reference
+	for (myIndex = 0; myIndex < theNumTargets; myIndex++) {
+		Handle		myDataRef = theTargets[myIndex].fDataRef;
+		
+		myPtr = QTShortCut_PutDescriptorPrefix(myPtr, &theTargets[myIndex]);
+		
+		myStates[myIndex] = HGetState(myDataRef);
+		HLock(myDataRef);
+		
+		myBlocks[(2 * myIndex) + 0] = myStart;
+		mySizes[(2 * myIndex) + 0] = myPtr - myStart;
+		myBlocks[(2 * myIndex) + 1] = *myDataRef;
+		mySizes[(2 * myIndex) + 1] = GetHandleSize(myDataRef);
+		
+		myStart = myPtr;
+	}
+	
+	myErr = QTShortCut_WriteDataToFile(myBlocks, mySizes, 2 * theNumTargets, theFSSpecPtr, kShortcutFlushVolumePerFile);
+	
+	// restore the states in the reverse order, so that a data reference used by more than one target gets back the
+	// state it had before the first of them locked it
+	for (myIndex = theNumTargets - 1; myIndex >= 0; myIndex--)
+		HSetState(theTargets[myIndex].fDataRef, myStates[myIndex]);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_NewRefMovieTable
+// Prepare the targets of the specified reference movie data (the contents of a reference movie file, such as one
+// written by QTShortCut_CreateReferenceMovieFile) for selection with QTShortCut_SelectRefMovieTarget.
+//
+// The movie atom is searched for a reference movie record atom; any other atoms in it (for instance, those of
+// a fallback movie) are ignored, as are any unknown atoms in the reference movie descriptor atoms. The targets
+// and their data references are copied into a single block of memory, and sorted by data rate and then quality,
+// so that the first target whose conditions a client meets is the one it should get. If the data isn't a well-formed
+// reference movie, the function result is invalidAtomErr.
+//
+//////////
+
+OSErr QTShortCut_NewRefMovieTable (Ptr theData, long theSize, QTShortCutRefMovieTablePtr *theTable)
+{
+	QTShortCutRefMovieTablePtr	myTable = NULL;
+	QTShortCutRefMovieChoice	myChoice;
+	long						myRecordStart, myRecordEnd;
+	long						myOffset;
+	long						myAtomSize;
+	long						myHeaderSize;
+	OSType						myAtomType;
+	long						myNumChoices = 0L;
+	long						myDataSize = 0L;
+	long						myDataOffset;
+	long						myIndex, myInner;
+
+	if ((theData == NULL) || (theTable == NULL))
+		return(paramErr);
+	
+	*theTable = NULL;
+	
+	// the data must be a single movie atom, which must contain a reference movie record atom
+	if (!QTShortCut_GetAtomHeader(theData, theSize, 0L, &myAtomSize, &myAtomType, &myHeaderSize) || (myAtomType != MovieAID))
+		return(invalidAtomErr);
+	
+	myRecordStart = QTShortCut_FindAtom(theData, myHeaderSize, myAtomSize, ReferenceMovieRecordAID, &myAtomSize, &myHeaderSize);
+	if (myRecordStart < 0)
+		return(invalidAtomErr);
+	
+	myRecordEnd = myRecordStart + myAtomSize;
+	myRecordStart += myHeaderSize;
+	
+	// count the descriptor atoms and add up the sizes of their data references, so that the table can be allocated at once
+	for (myOffset = myRecordStart; myOffset < myRecordEnd; myOffset += myAtomSize) {
+		if (!QTShortCut_GetAtomHeader(theData, myRecordEnd, myOffset, &myAtomSize, &myAtomType, &myHeaderSize))
+			return(invalidAtomErr);
+		
+		if (myAtomType != ReferenceMovieDescriptorAID)
+			continue;
+		
+		if (!QTShortCut_ParseDescriptor(theData, myOffset + myHeaderSize, myOffset + myAtomSize, &myChoice))
+			return(invalidAtomErr);
+		
+		myNumChoices++;
+		myDataSize += myChoice.fDataRefSize;
+	}
+	
+	if (myNumChoices == 0)
+		return(invalidAtomErr);
+	
+	myDataOffset = sizeof(struct QTShortCutRefMovieTable) + ((myNumChoices - 1) * sizeof(QTShortCutRefMovieChoice));
+	myTable = (QTShortCutRefMovieTablePtr)NewPtr(myDataOffset + myDataSize);
+	if (myTable == NULL)
+		return(MemError());
+	
+	// fill in the table, keeping it sorted (there are seldom more than a handful of targets)
+	myTable->fNumChoices = 0L;
+	for (myOffset = myRecordStart; myOffset < myRecordEnd; myOffset += myAtomSize) {
+		QTShortCut_GetAtomHeader(theData, myRecordEnd, myOffset, &myAtomSize, &myAtomType, &myHeaderSize);
+		if (myAtomType != ReferenceMovieDescriptorAID)
+			continue;
+		
+		QTShortCut_ParseDescriptor(theData, myOffset + myHeaderSize, myOffset + myAtomSize, &myChoice);
+		
+		BlockMoveData(theData + myChoice.fDataRefOffset, (Ptr)myTable + myDataOffset, myChoice.fDataRefSize);
+		myChoice.fDataRefOffset = myDataOffset;
+		myDataOffset += myChoice.fDataRefSize;
+		
+		myIndex = myTable->fNumChoices++;
+		for (myInner = myIndex; (myInner > 0) && QTShortCut_IsChoiceBetter(&myChoice, &myTable->fChoices[myInner - 1]); myInner--)
+			myTable->fChoices[myInner] = myTable->fChoices[myInner - 1];
+		myTable->fChoices[myInner] = myChoice;
+	}
+	
+	*theTable = myTable;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_DisposeRefMovieTable
+// Dispose of the specified table of reference movie targets.
+//
+//////////
+
+void QTShortCut_DisposeRefMovieTable (QTShortCutRefMovieTablePtr theTable)
+{
+	if (theTable != NULL)
+		DisposePtr((Ptr)theTable);
+}
+
+
+//////////
+//
+// QTShortCut_SelectRefMovieTarget
+// Choose the target in the specified table that the specified client should get: the one with the highest data rate
+// that the client's connection can sustain, and (among those) the highest quality, whose CPU speed, version, and
+// component conditions the client meets.
+//
+// On success, theDataRefType, theDataRefPtr and theDataRefSize receive the type, address and size of the target's
+// data reference, which belongs to the table; nothing is allocated. If the client meets the conditions of none of
+// the targets, the function result is noMovieFound.
+//
+//////////
+
+OSErr QTShortCut_SelectRefMovieTarget (QTShortCutRefMovieTablePtr theTable, QTShortCutClientInfoPtr theClient, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize)
+{
+	QTShortCutRefMovieChoicePtr		myChoice;
+	long							myIndex;
+	
+	if ((theTable == NULL) || (theClient == NULL) || (theDataRefType == NULL) || (theDataRefPtr == NULL) || (theDataRefSize == NULL))
+		return(paramErr);
+	
+	for (myIndex = 0, myChoice = theTable->fChoices; myIndex < theTable->fNumChoices; myIndex++, myChoice++) {
+		if ((myChoice->fDataRate > theClient->fDataRate) || (myChoice->fCPUSpeed > theClient->fCPUSpeed))
+			continue;
+		
+		if ((myChoice->fChecks != 0) && !QTShortCut_ClientMeetsChecks(myChoice, theClient))
+			continue;
+		
+		*theDataRefType = myChoice->fDataRefType;
+		*theDataRefPtr = (Ptr)theTable + myChoice->fDataRefOffset;
+		*theDataRefSize = myChoice->fDataRefSize;
+		return(noErr);
+	}
+	
+	return(noMovieFound);
+}
+
+
+//////////
+//
+// QTShortCut_SetShortcutWriter
+// Set how QTShortCut_CreateShortcutMovieFile and QTShortCut_CreateShortcutMovieFiles create shortcut files:
+//
+//	kShortcutWriterAuto				use CreateShortcutMovieFile under QuickTime 4.0 or greater, or else build the file ourselves
+//	kShortcutWriterToolbox			always use CreateShortcutMovieFile
+//	kShortcutWriterManual			always build the file ourselves (on platforms without the Movie Toolbox, for instance)
+//
+// Under kShortcutWriterAuto, the QuickTime version is checked the first time a shortcut is created, and never again.
+//
+//////////
+
+void QTShortCut_SetShortcutWriter (short theWriter)
+{
+	gShortcutWriter = theWriter;
+	
+	switch (theWriter) {
+		case kShortcutWriterToolbox:
+			gCreateShortcutProc = QTShortCut_CreateShortcutWithToolbox;
+			break;
+		
+		case kShortcutWriterManual:
+			gCreateShortcutProc = QTShortCut_CreateShortcutManually;
+			break;
+		
+		case kShortcutWriterAuto:
+		default:
+			gShortcutWriter = kShortcutWriterAuto;
+			gCreateShortcutProc = NULL;
+			break;
+	}
+}
+
+
+//////////
+//
+// QTShortCut_GetShortcutWriter
+// Get the way shortcut files are created (kShortcutWriterToolbox or kShortcutWriterManual); if the choice
+// is left to us and we haven't made it yet, make it now.
+//
+//////////
+
+short QTShortCut_GetShortcutWriter (void)
+{
+	if ((gCreateShortcutProc == NULL) && (QTShortCut_ChooseShortcutWriter() != noErr))
+		return(kShortcutWriterAuto);
+	
+	return((gCreateShortcutProc == QTShortCut_CreateShortcutWithToolbox) ? kShortcutWriterToolbox : kShortcutWriterManual);
+}
+
+
+//////////
+//
+// QTShortCut_SetInstrumentation
+// Turn on or off the recording of how long each step in creating a shortcut file takes (see the kShortcutPhase
+// constants); the steps timed are those of QTShortCut_CreateShortcutMovieFile and of the synchronous file writer
+// used by QTShortCut_WriteHandleToFile and the batch calls. The times accumulate until QTShortCut_ResetPhaseStats
+// is called, and can be read with QTShortCut_GetPhaseStats at any time, for instance while a long batch is running.
+//
+// When instrumentation is off (the default), each step costs just a test of a global variable.
+//
+//////////
+
+void QTShortCut_SetInstrumentation (Boolean theEnabled)
+{
+	gInstrumenting = theEnabled;
+}
+
+
+//////////
+//
+// QTShortCut_GetPhaseStats
+// Get the times recorded for the specified step in creating shortcut files.
+//
+//////////
+
+void QTShortCut_GetPhaseStats (short thePhase, QTShortCutPhaseStatsPtr theStats)
+{
+	QTShortCutPhaseHistogram *	myHistogram;
+	unsigned long				mySoFar = 0L;
+	Boolean						myHaveP50 = false;
+	Boolean						myHaveP99 = false;
+	short						myBucket;
+	
+	if (theStats == NULL)
+		return;
+	
+	BlockZero(theStats, sizeof(QTShortCutPhaseStats));
+	
+	if ((thePhase < 0) || (thePhase >= kShortcutNumPhases))
+		return;
+	
+	myHistogram = &gPhaseHistograms[thePhase];
+	theStats->fCount = myHistogram->fCount;
+	theStats->fTotal = myHistogram->fTotal;
+	theStats->fMax = myHistogram->fMax;
+	
+	// the percentiles are the largest times that fall in the buckets where the counts pass 50% and 99%
+	for (myBucket = 0; (myBucket < kShortcutNumTimeBuckets) && (myHistogram->fCount > 0); myBucket++) {
+		unsigned long	myLimit = (myBucket == 0) ? 0L : (0xFFFFFFFF >> (32 - myBucket));
+		
+		// the last bucket also holds any longer times
+		if ((myLimit > myHistogram->fMax) || (myBucket == kShortcutNumTimeBuckets - 1))
+			myLimit = myHistogram->fMax;
+		
+		mySoFar += myHistogram->fBuckets[myBucket];
+		if (!myHaveP50 && ((double)mySoFar * 2 >= (double)myHistogram->fCount)) {
+			theStats->fP50 = myLimit;
+			myHaveP50 = true;
+		}
+		if (!myHaveP99 && ((double)mySoFar * 100 >= (double)myHistogram->fCount * 99)) {
+			theStats->fP99 = myLimit;
+			myHaveP99 = true;
+		}
+	}
+}
+
+
+//////////
+//
+// QTShortCut_ResetPhaseStats
+// Forget all the times recorded for the steps in creating shortcut files.
+//
+//////////
+
+void QTShortCut_ResetPhaseStats (void)
+{
+	BlockZero(gPhaseHistograms, sizeof(gPhaseHistograms));
+}
+
+
+//////////
+//
+// QTShortCut_SetWriteFlags
+// Set the flags that control how shortcut files (and files written by QTShortCut_WriteHandleToFile) are written.
+//
+// If kShortcutWriteAtomicReplace is set, each file is first written to a temporary file in the same folder,
+// which is then swapped with the existing file (using FSpExchangeFiles) or renamed to take its place; a client
+// opening the file at any moment sees either the old shortcut or the new one, never a missing or partial file.
+//
+// If kShortcutWriteDedupTargets is set, QTShortCut_CreateShortcutMovieFiles writes the files in a batch that have
+// the same target as an earlier file from that file's data reference (see QTShortCut_CreateShortcutMovieFiles).
+//
+//////////
+
+void QTShortCut_SetWriteFlags (long theFlags)
+{
+	gWriteFlags = theFlags;
+}
+
+
+//////////
+//
+// QTShortCut_GetWriteFlags
+// Get the flags that control how shortcut files are written.
+//
+//////////
+
+long QTShortCut_GetWriteFlags (void)
+{
+	return(gWriteFlags);
+}
+
+
+//////////
+//
+// QTShortCut_SetBatchFlushPolicy
+// Set the policy that determines when the files written by QTShortCut_CreateShortcutMovieFiles and
+// QTShortCut_CreateShortcutMovieFilesInParallel are flushed to disk:
+//
+//	kShortcutFlushNone				never flush; leave it to the File Manager
+//	kShortcutFlushAtEndOfBatch		flush each volume once, when the batch is done (the default)
+//	kShortcutFlushPerFolder			flush the volume each time the batch moves on to a different folder
+//	kShortcutFlushPerFile			flush each file before closing it
+//	kShortcutFlushVolumePerFile		flush the volume after writing each file (as QTShortCut_CreateShortcutMovieFile does)
+//
+// The Mac OS File Manager can't flush a folder by itself, so kShortcutFlushPerFolder flushes the whole volume.
+// The flush policy has no effect on Windows.
+//
+//////////
+
+void QTShortCut_SetBatchFlushPolicy (short thePolicy)
+{
+	gBatchFlushPolicy = thePolicy;
+}
+
+
+//////////
+//
+// QTShortCut_GetBatchFlushPolicy
+// Get the policy that determines when the files written during a batch are flushed to disk.
+//
+//////////
+
+short QTShortCut_GetBatchFlushPolicy (void)
+{
+	return(gBatchFlushPolicy);
+}
+
+
+//////////
+//
+// QTShortCut_ChooseShortcutWriter
+// Decide how to create shortcut files, depending on the version of QuickTime that's running.
+//
+//////////
+
+static OSErr QTShortCut_ChooseShortcutWriter (void)
+{
+	long	 	myVersion = 0L;
+	OSErr		myErr = noErr;
+	
+	myErr = Gestalt(gestaltQuickTime, &myVersion);
+	if (myErr != noErr)
+		return(myErr);
+
+	if (((myVersion >> 16) & 0xffff) >= 0x0400)
+		// we're running under QuickTime 4.0 or greater; we can use the function CreateShortcutMovieFile
+		gCreateShortcutProc = QTShortCut_CreateShortcutWithToolbox;
+	else
+		// we're running under a version of QuickTime prior to 4.0; do the grunt work ourselves
+		gCreateShortcutProc = QTShortCut_CreateShortcutManually;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutWithToolbox
+// Create a shortcut movie file using the Movie Toolbox function CreateShortcutMovieFile (QuickTime 4.0 or greater).
+//
+//////////
+
+static OSErr QTShortCut_CreateShortcutWithToolbox (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr)
+{
+	FSSpec			myTempFSSpec;
+	unsigned long	myStart;
+	OSErr			myErr = noErr;
+	
+	if ((gWriteFlags & kShortcutWriteAtomicReplace) == 0) {
+		myStart = QTShortCut_StartPhase();
+		myErr = CreateShortcutMovieFile(theFSSpecPtr,
+										kShortcutFileCreator,
+								 		smCurrentScript,
+										createMovieFileDeleteCurFile | createMovieFileDontCreateResFile,
+										theDataRef,
+										theDataRefType);
+		QTShortCut_EndPhase(kShortcutPhaseToolbox, myStart);
+		
+		QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+		return(myErr);
+	}
+	
+	// create the shortcut under a temporary name and then move it into place
+	myErr = QTShortCut_MakeTempFSSpec(theFSSpecPtr, &myTempFSSpec);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myStart = QTShortCut_StartPhase();
+	myErr = CreateShortcutMovieFile(&myTempFSSpec,
+									kShortcutFileCreator,
+							 		smCurrentScript,
+									createMovieFileDeleteCurFile | createMovieFileDontCreateResFile,
+									theDataRef,
+									theDataRefType);
+	QTShortCut_EndPhase(kShortcutPhaseToolbox, myStart);
+	
+	if (myErr == noErr) {
+		myStart = QTShortCut_StartPhase();
+		myErr = QTShortCut_ReplaceWithTempFile(&myTempFSSpec, theFSSpecPtr);
+		QTShortCut_EndPhase(kShortcutPhaseReplace, myStart);
+	}
+
+	QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutManually
+// Create a shortcut movie file by building its atoms ourselves (for QuickTime versions prior to 4.0).
+//
+//////////
+
+static OSErr QTShortCut_CreateShortcutManually (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr)
+{
+	//////////
+	//
+	// create the shortcut movie file; its movie atom contains a movie data reference alias atom, which
+	// contains a data reference atom, whose data is the data reference type followed by the data reference
+	// itself; the atom headers and the data reference type are assembled in a small buffer on the stack,
+	// and the data reference is written to the file directly from the specified handle
+	//
+	//////////
+	
+	return(QTShortCut_WriteShortcutData(theDataRef, theDataRefType, theFSSpecPtr, kShortcutFlushVolumePerFile));
+}
+
+
+//////////
+//
+// QTShortCut_FillShortcutHeader
+// Fill in the specified buffer with the size and type fields of the movie atom, of the movie data reference
+// alias atom contained in it, and of the data reference atom contained in the movie data reference alias atom,
+// followed by the data reference type; the data reference itself (theDataRefSize bytes) should follow these
+// kShortcutHeaderSize bytes in the shortcut file.
+//
+// The atom types never change, so they're copied from a template that's already in big-endian order;
+// only the three sizes and the data reference type are filled in.
+//
+//////////
+
+static void QTShortCut_FillShortcutHeader (long theDataRefSize, OSType theDataRefType, Ptr theHeader)
+{
+	unsigned long		myDataSize = kShortcutFieldSize + (unsigned long)theDataRefSize;
+
+	BlockMoveData(gShortcutHeaderTemplate, theHeader, kShortcutHeaderSize);
+	
+	// each atom header is followed by the next, and each atom holds the ones after it
+	QTShortCut_PutBigEndianLong(theHeader + (0 * kRefMovieAtomHeaderSize), (3 * kRefMovieAtomHeaderSize) + myDataSize);
+	QTShortCut_PutBigEndianLong(theHeader + (1 * kRefMovieAtomHeaderSize), (2 * kRefMovieAtomHeaderSize) + myDataSize);
+	QTShortCut_PutBigEndianLong(theHeader + (2 * kRefMovieAtomHeaderSize), (1 * kRefMovieAtomHeaderSize) + myDataSize);
+	QTShortCut_PutBigEndianLong(theHeader + (3 * kRefMovieAtomHeaderSize), theDataRefType);
+}
+
+
+//////////
+//
+// QTShortCut_FillExtendedShortcutHeader
+// Fill in the specified buffer with the atom headers and data reference type that precede a data reference of the
+// specified (64-bit) size, and return the number of bytes filled in: kShortcutHeaderSize if the atom sizes all fit
+// in 32 bits, or kShortcutExtendedHeaderSize if the atoms need extended sizes. Return 0 if the sizes overflow.
+//
+//////////
+
+static long QTShortCut_FillExtendedShortcutHeader (UnsignedWide theDataRefSize, OSType theDataRefType, Ptr theHeader)
+{
+	UnsignedWide	mySize = theDataRefSize;
+	OSType			myAtomTypes[3];
+	Ptr				myPtr;
+	short			myIndex;
+	
+	if ((theDataRefSize.hi == 0) && (theDataRefSize.lo <= 0xFFFFFFFFUL - kShortcutHeaderSize)) {
+		// the sizes fit; fill in the header just as QTShortCut_CreateShortcutMovieFile does
+		QTShortCut_FillShortcutHeader((long)theDataRefSize.lo, theDataRefType, theHeader);
+		return(kShortcutHeaderSize);
+	}
+	
+	myAtomTypes[0] = DataRefAID;
+	myAtomTypes[1] = MovieDataRefAliasAID;
+	myAtomTypes[2] = MovieAID;
+	
+	// work out the sizes from the innermost atom outwards, and fill them in from the end of the header backwards
+	if (!QTShortCut_AddToWide(&mySize, kShortcutFieldSize))
+		return(0L);
+	
+	QTShortCut_PutBigEndianLong(theHeader + kShortcutExtendedHeaderSize - kShortcutFieldSize, theDataRefType);
+	
+	for (myIndex = 0; myIndex < 3; myIndex++) {
+		if (!QTShortCut_AddToWide(&mySize, kExtendedAtomHeaderSize))
+			return(0L);
+		
+		myPtr = theHeader + ((2 - myIndex) * kExtendedAtomHeaderSize);
+		myPtr = QTShortCut_PutAtomHeader(myPtr, 1L, myAtomTypes[myIndex]);
+		myPtr = QTShortCut_PutBigEndianLong(myPtr, mySize.hi);
+		myPtr = QTShortCut_PutBigEndianLong(myPtr, mySize.lo);
+	}
+	
+	return(kShortcutExtendedHeaderSize);
+}
+
+
+//////////
+//
+// QTShortCut_AddSize
+// Add theSize to the size in theTotal; return false (leaving theTotal alone) if theSize is negative or if the
+// sum would be larger than kShortcutMaxFileSize.
+//
+//////////
+
+static Boolean QTShortCut_AddSize (long *theTotal, long theSize)
+{
+	if ((theSize < 0) || (theSize > kShortcutMaxFileSize - *theTotal))
+		return(false);
+	
+	*theTotal += theSize;
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_AddToWide
+// Add theValue to the 64-bit value in theWide; return false (leaving theWide alone) if the sum doesn't fit in 64 bits.
+//
+//////////
+
+static Boolean QTShortCut_AddToWide (UnsignedWide *theWide, unsigned long theValue)
+{
+	if (theWide->lo > 0xFFFFFFFFUL - theValue) {
+		if (theWide->hi == 0xFFFFFFFFUL)
+			return(false);
+		theWide->hi++;
+	}
+	
+	theWide->lo += theValue;
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_WriteShortcutData
+// Write a shortcut to the specified data reference into the specified file, without copying the data reference.
+//
+//////////
+
+static OSErr QTShortCut_WriteShortcutData (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr, short theFlushPolicy)
+{
+	unsigned char		myHeader[kShortcutHeaderSize];
+	unsigned long		myStart;
+
+	if (theDataRef == NULL)
+		return(paramErr);
+	
+	myStart = QTShortCut_StartPhase();
+	QTShortCut_FillShortcutHeader(GetHandleSize(theDataRef), theDataRefType, (Ptr)myHeader);
+	QTShortCut_EndPhase(kShortcutPhaseAssemble, myStart);
+	
+	return(QTShortCut_WriteShortcutWithHeader(theDataRef, (Ptr)myHeader, theFSSpecPtr, theFlushPolicy));
+}
+
+
+//////////
+//
+// QTShortCut_WriteShortcutWithHeader
+// Write a shortcut to the specified data reference into the specified file, using a header already filled in
+// by QTShortCut_FillShortcutHeader for that data reference.
+//
+//////////
+
+static OSErr QTShortCut_WriteShortcutWithHeader (Handle theDataRef, Ptr theHeader, FSSpecPtr theFSSpecPtr, short theFlushPolicy)
+{
+	Ptr					myBlocks[2];
+	long				mySizes[2];
+	SignedByte			myState;
+	OSErr				myErr = noErr;
+
+	if ((theDataRef == NULL) || (theHeader == NULL))
+		return(paramErr);
+	
+	if (GetHandleSize(theDataRef) > kShortcutMaxFileSize - kShortcutHeaderSize)
+		return(paramErr);
+	
+	// lock the data reference while we write it, restoring its original state afterwards
+	myState = HGetState(theDataRef);
+	HLock(theDataRef);
+
+	myBlocks[0] = theHeader;
+	mySizes[0] = kShortcutHeaderSize;
+	myBlocks[1] = *theDataRef;
+	mySizes[1] = GetHandleSize(theDataRef);
+
+	myErr = QTShortCut_WriteDataToFile(myBlocks, mySizes, 2, theFSSpecPtr, theFlushPolicy);
+	
+	HSetState(theDataRef, myState);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteHandleToFile
+// Write the data in the specified handle into the specified file;
+// if the file already exists, it is overwritten.
+//
+//////////
+
+OSErr QTShortCut_WriteHandleToFile (Handle theHandle, FSSpecPtr theFSSpecPtr)
+{
+	Ptr				myData;
+	long			mySize = 0;
+	OSErr			myErr = paramErr;
+
+	if (theHandle == NULL)
+		goto bail;
+
+	mySize = GetHandleSize(theHandle);
+	if (mySize == 0)
+		goto bail;
+
+	HLock(theHandle);
+	
+	myData = *theHandle;
+	myErr = QTShortCut_WriteDataToFile(&myData, &mySize, 1, theFSSpecPtr, kShortcutFlushVolumePerFile);
+
+bail:
+	HUnlock(theHandle);
+
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_NewOutputContext
+// Create an output context for the specified folder, through which files can be written into the folder by name
+// (see QTShortCut_CreateShortcutInContext); the folder is looked up just once, here. The names given must be plain
+// file names, without colons, so that every file written through the context ends up in the context's folder.
+//
+// The files written through the context are flushed according to the batch flush policy in effect now (see
+// QTShortCut_SetBatchFlushPolicy): kShortcutFlushAtEndOfBatch and kShortcutFlushPerFolder put off flushing the
+// volume until QTShortCut_FlushOutputContext or QTShortCut_DisposeOutputContext is called.
+//
+//////////
+
+OSErr QTShortCut_NewOutputContext (short theVRefNum, long theDirID, QTShortCutOutputContextPtr *theContext)
+{
+	QTShortCutOutputContextPtr	myContext = NULL;
+	CInfoPBRec					myPB;
+	OSErr						myErr = noErr;
+	
+	if (theContext == NULL)
+		return(paramErr);
+	
+	*theContext = NULL;
+	
+	// make sure that the folder exists, and is a folder
+	myPB.dirInfo.ioCompletion = NULL;
+	myPB.dirInfo.ioNamePtr = NULL;
+	myPB.dirInfo.ioVRefNum = theVRefNum;
+	myPB.dirInfo.ioFDirIndex = -1;
+	myPB.dirInfo.ioDrDirID = theDirID;
+	
+	myErr = PBGetCatInfoSync(&myPB);
+	if (myErr != noErr)
+		return(myErr);
+	
+	if ((myPB.dirInfo.ioFlAttrib & ioDirMask) == 0)
+		return(dirNFErr);
+	
+	myContext = (QTShortCutOutputContextPtr)NewPtrClear(sizeof(struct QTShortCutOutputContext));
+	if (myContext == NULL)
+		return(MemError());
+	
+	myContext->fVRefNum = theVRefNum;
+	myContext->fDirID = theDirID;
+	myContext->fFlushPolicy = gBatchFlushPolicy;
+#if POSIX_SHORTCUTS
+	myContext->fDirFD = -1;
+#endif
+	
+	*theContext = myContext;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutInContext
+// Create a shortcut movie file with the specified name, in the folder of the specified output context, that is a
+// shortcut to the specified data reference; if the file already exists, it is overwritten.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutInContext (QTShortCutOutputContextPtr theContext, Handle theDataRef, OSType theDataRefType, ConstStr255Param theName)
+{
+	unsigned char		myHeader[kShortcutHeaderSize];
+	Ptr					myBlocks[2];
+	long				mySizes[2];
+	SignedByte			myState;
+	unsigned long		myStart;
+	OSErr				myErr = noErr;
+
+	if ((theContext == NULL) || (theDataRef == NULL) || (GetHandleSize(theDataRef) > kShortcutMaxFileSize - kShortcutHeaderSize))
+		return(paramErr);
+	
+	myStart = QTShortCut_StartPhase();
+	QTShortCut_FillShortcutHeader(GetHandleSize(theDataRef), theDataRefType, (Ptr)myHeader);
+	QTShortCut_EndPhase(kShortcutPhaseAssemble, myStart);
+	
+	myState = HGetState(theDataRef);
+	HLock(theDataRef);
+
+	myBlocks[0] = (Ptr)myHeader;
+	mySizes[0] = kShortcutHeaderSize;
+	myBlocks[1] = *theDataRef;
+	mySizes[1] = GetHandleSize(theDataRef);
+
+	myErr = QTShortCut_WriteDataInContext(theContext, theName, myBlocks, mySizes, 2);
+	
+	HSetState(theDataRef, myState);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteHandleInContext
+// Write the data in the specified handle into the file with the specified name, in the folder of the specified
+// output context; if the file already exists, it is overwritten.
+//
+//////////
+
+OSErr QTShortCut_WriteHandleInContext (QTShortCutOutputContextPtr theContext, Handle theHandle, ConstStr255Param theName)
+{
+	Ptr				myData;
+	long			mySize = 0;
+	SignedByte		myState;
+	OSErr			myErr = noErr;
+
+	if ((theContext == NULL) || (theHandle == NULL))
+		return(paramErr);
+
+	mySize = GetHandleSize(theHandle);
+	if (mySize == 0)
+		return(paramErr);
+
+	myState = HGetState(theHandle);
+	HLock(theHandle);
+	
+	myData = *theHandle;
+	myErr = QTShortCut_WriteDataInContext(theContext, theName, &myData, &mySize, 1);
+
+	HSetState(theHandle, myState);
+
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_FlushOutputContext
+// Flush the files written through the specified output context, if its flush policy put that off until now.
+//
+//////////
+
+OSErr QTShortCut_FlushOutputContext (QTShortCutOutputContextPtr theContext)
+{
+	OSErr			myErr = noErr;
+	
+	if (theContext == NULL)
+		return(paramErr);
+	
+	if (!theContext->fNeedsFlush || ((theContext->fFlushPolicy != kShortcutFlushAtEndOfBatch) && (theContext->fFlushPolicy != kShortcutFlushPerFolder)))
+		return(noErr);
+	
+#if POSIX_SHORTCUTS
+	if (theContext->fDirFD >= 0) {
+		myErr = QTShortCut_FlushPendingFiles(&theContext->fPending, theContext->fDirFD);
+	} else {
+#endif
+#if TARGET_OS_MAC	
+		myErr = FlushVol(NULL, theContext->fVRefNum);
+#endif	// TARGET_OS_MAC	
+#if POSIX_SHORTCUTS
+	}
+#endif
+	
+	if (myErr == noErr)
+		theContext->fNeedsFlush = false;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_DisposeOutputContext
+// Flush the files written through the specified output context (see QTShortCut_FlushOutputContext),
+// and dispose of the context.
+//
+//////////
+
+void QTShortCut_DisposeOutputContext (QTShortCutOutputContextPtr theContext)
+{
+	if (theContext == NULL)
+		return;
+	
+	QTShortCut_FlushOutputContext(theContext);
+	
+#if POSIX_SHORTCUTS
+	if (theContext->fDirFD >= 0)
+		close(theContext->fDirFD);
+#endif
+	
+	DisposePtr((Ptr)theContext);
+}
+
+
+#if POSIX_SHORTCUTS
+//////////
+//
+// QTShortCut_CreateShortcutMovieFileAtPath
+// Create a movie file at the specified POSIX path that is a shortcut to the specified data reference.
+//
+// This and the other POSIX file functions write with open, pwrite, and close, rather than through the File Manager,
+// so a build for a POSIX system needs no FSSpecs. The folder that a file goes into is opened once and kept open,
+// and the file is opened relative to it (with openat); a run of files written to the same folder looks the folder
+// up only once. The shortcut file is always assembled by hand, and is the same as one written through an FSSpec.
+// The write flags (see QTShortCut_SetWriteFlags) apply here too.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutMovieFileAtPath (Handle theDataRef, OSType theDataRefType, const char *thePath)
+{
+	return(QTShortCut_WriteShortcutDataToPath(theDataRef, theDataRefType, thePath, kShortcutFlushVolumePerFile));
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutMovieFilesAtPaths
+// Create a batch of shortcut movie files at the specified POSIX paths, as QTShortCut_CreateShortcutMovieFiles does.
+//
+// Files in the same folder should be kept together in the batch, so that the folder is opened just once for them.
+// The batch flush policy is followed as closely as POSIX allows: kShortcutFlushPerFile calls fsync on each file, and
+// kShortcutFlushVolumePerFile calls fsync on each file and its folder. There's no portable way to flush a single
+// volume, and sync would flush every other process's data too, so under kShortcutFlushAtEndOfBatch and
+// kShortcutFlushPerFolder each file is kept open until the batch moves on to a different folder (or ends), and then
+// the folder's files and the folder itself are flushed with fsync; only the files written by the batch are flushed.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutMovieFilesAtPaths (Handle theDataRefs[], OSType theDataRefTypes[], const char *thePaths[], long theCount, OSErr theErrors[])
+{
+	long		myIndex;
+	OSErr		myItemErr = noErr;
+	OSErr		myErr = noErr;
+	
+	if ((theDataRefs == NULL) || (theDataRefTypes == NULL) || (thePaths == NULL) || (theCount < 0))
+		return(paramErr);
+	
+	// the files of each folder are flushed when the batch moves on to the next (see QTShortCut_OpenPathFolder)
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		myItemErr = QTShortCut_WriteShortcutDataToPath(theDataRefs[myIndex], theDataRefTypes[myIndex], thePaths[myIndex], gBatchFlushPolicy);
+		
+		if (theErrors != NULL)
+			theErrors[myIndex] = myItemErr;
+			
+		if ((myErr == noErr) && (myItemErr != noErr))
+			myErr = myItemErr;
+	}
+	
+	// flush the files written to the last folder, and the folder itself
+	myItemErr = QTShortCut_FlushPendingFiles(&gPendingFiles, gDirFD);
+	if (myErr == noErr)
+		myErr = myItemErr;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteHandleToPath
+// Write the data in the specified handle into the file at the specified POSIX path;
+// if the file already exists, it is overwritten.
+//
+//////////
+
+OSErr QTShortCut_WriteHandleToPath (Handle theHandle, const char *thePath)
+{
+	Ptr				myData;
+	long			mySize = 0;
+	SignedByte		myState;
+	OSErr			myErr = paramErr;
+
+	if (theHandle == NULL)
+		return(paramErr);
+
+	mySize = GetHandleSize(theHandle);
+	if (mySize == 0)
+		return(paramErr);
+
+	myState = HGetState(theHandle);
+	HLock(theHandle);
+	
+	myData = *theHandle;
+	myErr = QTShortCut_WriteDataToPath(&myData, &mySize, 1, thePath, kShortcutFlushVolumePerFile);
+
+	HSetState(theHandle, myState);
+
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_NewOutputContextForPath
+// Create an output context for the folder at the specified POSIX path (see QTShortCut_NewOutputContext); the
+// context holds the folder open, and files are opened relative to it (with openat), by name alone.
+//
+//////////
+
+OSErr QTShortCut_NewOutputContextForPath (const char *theDirPath, QTShortCutOutputContextPtr *theContext)
+{
+	QTShortCutOutputContextPtr	myContext = NULL;
+	int							myFlags = O_RDONLY;
+	int							myFD;
+	
+	if ((theDirPath == NULL) || (theContext == NULL))
+		return(paramErr);
+	
+	*theContext = NULL;
+	
+#ifdef O_DIRECTORY
+	myFlags |= O_DIRECTORY;
+#endif
+	myFD = open(theDirPath, myFlags);
+	if (myFD < 0)
+		return((errno == ENOENT) ? dirNFErr : QTShortCut_GetErrnoError(errno));
+	
+	myContext = (QTShortCutOutputContextPtr)NewPtrClear(sizeof(struct QTShortCutOutputContext));
+	if (myContext == NULL) {
+		close(myFD);
+		return(memFullErr);
+	}
+	
+	myContext->fFlushPolicy = gBatchFlushPolicy;
+	myContext->fDirFD = myFD;
+	
+	*theContext = myContext;
+	
+	return(noErr);
+}
+#endif	// POSIX_SHORTCUTS
+
+
+//////////
+//
+// QTShortCut_WriteDataToFile
+// Write the specified blocks of data, one after the other, into the specified file; if the file already
+// exists, it is overwritten. The blocks are written straight from where they are, so the caller doesn't
+// need to gather them into a single buffer first.
+//
+// If theFlushPolicy is kShortcutFlushVolumePerFile, the volume is flushed once the file is closed; if it is
+// kShortcutFlushPerFile, just the file is flushed before it is closed. Otherwise, the caller is responsible
+// for flushing the volume (this allows a batch of files on the same volume to share a single call to FlushVol).
+//
+//////////
+
+static OSErr QTShortCut_WriteDataToFile (Ptr theBlocks[], long theSizes[], long theNumBlocks, FSSpecPtr theFSSpecPtr, short theFlushPolicy)
+{
+	FSSpec			myTempFSSpec;
+	FSSpecPtr		myFSSpecPtr = theFSSpecPtr;
+	Boolean			myAtomic = ((gWriteFlags & kShortcutWriteAtomicReplace) != 0);
+	short			myRefNum = 0;
+	short			myVolNum;
+	unsigned long	myStart;
+	OSErr			myErr = noErr;
+
+	// when replacing the file atomically, write the data into a temporary file
+	if (myAtomic) {
+		myErr = QTShortCut_MakeTempFSSpec(theFSSpecPtr, &myTempFSSpec);
+		if (myErr != noErr)
+			return(myErr);
+		myFSSpecPtr = &myTempFSSpec;
+	}
+	
+	// delete the file;
+	// if it doesn't exist yet, we'll get an error (fnfErr), which we just ignore
+	myStart = QTShortCut_StartPhase();
+	myErr = FSpDelete(myFSSpecPtr);
+	QTShortCut_EndPhase(kShortcutPhaseDelete, myStart);
+	
+	// create and open the file
+	myStart = QTShortCut_StartPhase();
+	myErr = FSpCreate(myFSSpecPtr, kShortcutFileCreator, kShortcutFileType, smSystemScript);
+	QTShortCut_EndPhase(kShortcutPhaseCreate, myStart);
+
+	if (myErr == noErr) {
+		myStart = QTShortCut_StartPhase();
+		myErr = FSpOpenDF(myFSSpecPtr, fsRdWrPerm, &myRefNum);
+		QTShortCut_EndPhase(kShortcutPhaseOpen, myStart);
+	}
+	
+#if TARGET_OS_MAC	
+	// get the volume reference number while the file is still open
+	if ((myErr == noErr) && (theFlushPolicy == kShortcutFlushVolumePerFile))		
+		myErr = GetVRefNum(myRefNum, &myVolNum);
+#endif	// TARGET_OS_MAC	
+
+	// write the data and close the file; a temporary file is brand new, so it doesn't need to be truncated
+	if (myRefNum != 0) {
+		if (myErr == noErr)
+			myErr = QTShortCut_WriteDataToOpenFile(myRefNum, theBlocks, theSizes, theNumBlocks, !myAtomic, theFlushPolicy);
+		else
+			FSClose(myRefNum);
+	}
+
+	// move the temporary file into place; if anything went wrong, the existing file is left untouched
+	if (myAtomic) {
+		myStart = QTShortCut_StartPhase();
+		if (myErr == noErr)
+			myErr = QTShortCut_ReplaceWithTempFile(myFSSpecPtr, theFSSpecPtr);
+		else
+			FSpDelete(myFSSpecPtr);
+		QTShortCut_EndPhase(kShortcutPhaseReplace, myStart);
+	}
+	
+	// whatever happened, the file may not hold the shortcut we last resolved from it
+	QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+
+#if TARGET_OS_MAC	
+	// flush the volume
+	if ((myErr == noErr) && (theFlushPolicy == kShortcutFlushVolumePerFile)) {
+		myStart = QTShortCut_StartPhase();
+		myErr = FlushVol(NULL, myVolNum);
+		QTShortCut_EndPhase(kShortcutPhaseFlushVolume, myStart);
+	}
+#endif	// TARGET_OS_MAC	
+
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteDataToOpenFile
+// Write the specified blocks of data, one after the other, into the open file with the specified reference number,
+// starting at the beginning of the file, and then close the file; if theTruncate is true, the file is cut off at
+// the end of the data, in case it used to be longer. The file is flushed if theFlushPolicy is kShortcutFlushPerFile.
+//
+// The file is closed even if something goes wrong, but the first error is the one reported, so that a long batch
+// doesn't run out of file reference numbers.
+//
+//////////
+
+static OSErr QTShortCut_WriteDataToOpenFile (short theRefNum, Ptr theBlocks[], long theSizes[], long theNumBlocks, Boolean theTruncate, short theFlushPolicy)
+{
+	long			myIndex;
+	long			mySize;
+	long			myTotalSize = 0;
+	unsigned long	myStart;
+	OSErr			myErr = noErr;
+	
+	// position the file mark to the beginning of the file and write the data
+	myStart = QTShortCut_StartPhase();
+	
+	if (theTruncate)
+		myErr = SetFPos(theRefNum, fsFromStart, 0);
+
+	for (myIndex = 0; (myIndex < theNumBlocks) && (myErr == noErr); myIndex++) {
+		mySize = theSizes[myIndex];
+		if (mySize > 0)
+			myErr = FSWrite(theRefNum, &mySize, theBlocks[myIndex]);
+		myTotalSize += mySize;
+	}
+
+	QTShortCut_EndPhase(kShortcutPhaseWrite, myStart);
+
+	// resize the file to the number of bytes written
+	if ((myErr == noErr) && theTruncate) {
+		myStart = QTShortCut_StartPhase();
+		myErr = SetFPos(theRefNum, fsFromStart, myTotalSize);
+		if (myErr == noErr)
+			myErr = SetEOF(theRefNum, myTotalSize);
+		QTShortCut_EndPhase(kShortcutPhaseTruncate, myStart);
+	}
+				
+#if TARGET_OS_MAC	
+	// flush the file's data to disk
+	if ((myErr == noErr) && (theFlushPolicy == kShortcutFlushPerFile)) {
+		ParamBlockRec	myPB;
+		
+		myStart = QTShortCut_StartPhase();
+		myPB.ioParam.ioCompletion = NULL;
+		myPB.ioParam.ioRefNum = theRefNum;
+		myErr = PBFlushFileSync(&myPB);
+		QTShortCut_EndPhase(kShortcutPhaseFlushFile, myStart);
+	}
+#endif	// TARGET_OS_MAC	
+
+	myStart = QTShortCut_StartPhase();
+	if (myErr == noErr)		
+		myErr = FSClose(theRefNum);
+	else
+		FSClose(theRefNum);
+	QTShortCut_EndPhase(kShortcutPhaseClose, myStart);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteDataInContext
+// Write the specified blocks of data, one after the other, into the file with the specified name in the folder
+// of the specified output context.
+//
+// On the Mac, an existing file is opened by name and overwritten, and a new one is created and then opened; so
+// there's one catalog lookup for a file that's being replaced (which is the usual case in a shortcut tree that's
+// being regenerated), instead of the three that deleting, creating, and opening it take. An existing file keeps
+// its type and creator. If files are to be replaced atomically, this takes the same route as QTShortCut_WriteDataToFile.
+//
+//////////
+
+static OSErr QTShortCut_WriteDataInContext (QTShortCutOutputContextPtr theContext, ConstStr255Param theName, Ptr theBlocks[], long theSizes[], long theNumBlocks)
+{
+	FSSpec			myFSSpec;
+	short			myPolicy = theContext->fFlushPolicy;
+	OSErr			myErr = noErr;
+	
+	if ((theName == NULL) || (theName[0] == 0))
+		return(bdNamErr);
+	
+	theContext->fNeedsFlush = true;
+	
+#if POSIX_SHORTCUTS
+	if (theContext->fDirFD >= 0) {
+		char		myName[256];
+		short		myIndex;
+		
+		for (myIndex = 0; myIndex < theName[0]; myIndex++) {
+			myName[myIndex] = theName[myIndex + 1];
+			if ((myName[myIndex] == '/') || (myName[myIndex] == '\0'))
+				return(bdNamErr);
+		}
+		myName[theName[0]] = '\0';
+		
+		return(QTShortCut_WriteDataAt(theContext->fDirFD, myName, theBlocks, theSizes, theNumBlocks, myPolicy, &theContext->fPending));
+	}
+#endif	// POSIX_SHORTCUTS
+	
+	// a name with a colon in it would be taken as a partial pathname, and could put the file outside the folder
+	if ((theName[0] > kShortcutMaxFileNameLength) || !QTShortCut_IsLeafName(theName))
+		return(bdNamErr);
+	
+	// the folder is already known, so the file's FSSpec can be filled in without looking anything up
+	myFSSpec.vRefNum = theContext->fVRefNum;
+	myFSSpec.parID = theContext->fDirID;
+	BlockMoveData(theName, myFSSpec.name, theName[0] + 1);
+	
+#if TARGET_OS_MAC	
+	if ((gWriteFlags & kShortcutWriteAtomicReplace) == 0) {
+		short			myRefNum = 0;
+		unsigned long	myStart;
+		
+		myStart = QTShortCut_StartPhase();
+		myErr = HOpenDF(myFSSpec.vRefNum, myFSSpec.parID, myFSSpec.name, fsRdWrPerm, &myRefNum);
+		QTShortCut_EndPhase(kShortcutPhaseOpen, myStart);
+		
+		if (myErr == fnfErr) {
+			myStart = QTShortCut_StartPhase();
+			myErr = HCreate(myFSSpec.vRefNum, myFSSpec.parID, myFSSpec.name, kShortcutFileCreator, kShortcutFileType);
+			QTShortCut_EndPhase(kShortcutPhaseCreate, myStart);
+			
+			if (myErr == noErr) {
+				myStart = QTShortCut_StartPhase();
+				myErr = HOpenDF(myFSSpec.vRefNum, myFSSpec.parID, myFSSpec.name, fsRdWrPerm, &myRefNum);
+				QTShortCut_EndPhase(kShortcutPhaseOpen, myStart);
+			}
+		}
+		
+		if (myErr == noErr)
+			myErr = QTShortCut_WriteDataToOpenFile(myRefNum, theBlocks, theSizes, theNumBlocks, true, myPolicy);
+		
+		QTShortCut_InvalidateShortcutCache(&myFSSpec);
+		
+		if ((myErr == noErr) && (myPolicy == kShortcutFlushVolumePerFile)) {
+			myStart = QTShortCut_StartPhase();
+			myErr = FlushVol(NULL, myFSSpec.vRefNum);
+			QTShortCut_EndPhase(kShortcutPhaseFlushVolume, myStart);
+		}
+		
+		return(myErr);
+	}
+#else
+	// on Windows, an FSSpec has to come from FSMakeFSSpec
+	myErr = FSMakeFSSpec(theContext->fVRefNum, theContext->fDirID, theName, &myFSSpec);
+	if ((myErr != noErr) && (myErr != fnfErr))
+		return(myErr);
+#endif	// TARGET_OS_MAC	
+	
+	return(QTShortCut_WriteDataToFile(theBlocks, theSizes, theNumBlocks, &myFSSpec, myPolicy));
+}
+
+
+#if POSIX_SHORTCUTS
+//////////
+//
+// QTShortCut_WriteShortcutDataToPath
+// Write a shortcut to the specified data reference into the file at the specified POSIX path.
+//
+//////////
+
+static OSErr QTShortCut_WriteShortcutDataToPath (Handle theDataRef, OSType theDataRefType, const char *thePath, short theFlushPolicy)
+{
+	unsigned char		myHeader[kShortcutHeaderSize];
+	Ptr					myBlocks[2];
+	long				mySizes[2];
+	SignedByte			myState;
+	unsigned long		myStart;
+	OSErr				myErr = noErr;
+
+	if ((theDataRef == NULL) || (GetHandleSize(theDataRef) > kShortcutMaxFileSize - kShortcutHeaderSize))
+		return(paramErr);
+	
+	myStart = QTShortCut_StartPhase();
+	QTShortCut_FillShortcutHeader(GetHandleSize(theDataRef), theDataRefType, (Ptr)myHeader);
+	QTShortCut_EndPhase(kShortcutPhaseAssemble, myStart);
+	
+	myState = HGetState(theDataRef);
+	HLock(theDataRef);
+
+	myBlocks[0] = (Ptr)myHeader;
+	mySizes[0] = kShortcutHeaderSize;
+	myBlocks[1] = *theDataRef;
+	mySizes[1] = GetHandleSize(theDataRef);
+
+	myErr = QTShortCut_WriteDataToPath(myBlocks, mySizes, 2, thePath, theFlushPolicy);
+	
+	HSetState(theDataRef, myState);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteDataToPath
+// Write the specified blocks of data, one after the other, into the file at the specified POSIX path, as
+// QTShortCut_WriteDataToFile does; the file is opened relative to its folder, which is kept open for the next file.
+//
+//////////
+
+static OSErr QTShortCut_WriteDataToPath (Ptr theBlocks[], long theSizes[], long theNumBlocks, const char *thePath, short theFlushPolicy)
+{
+	const char		*myName;
+	Boolean			myChanged;
+	OSErr			myErr = noErr;
+	
+	if (thePath == NULL)
+		return(paramErr);
+	
+	myErr = QTShortCut_OpenPathFolder(thePath, &myName, &myChanged);
+	if (myErr != noErr)
+		return(myErr);
+	
+	return(QTShortCut_WriteDataAt(gDirFD, myName, theBlocks, theSizes, theNumBlocks, theFlushPolicy, &gPendingFiles));
+}
+
+
+//////////
+//
+// QTShortCut_WriteDataAt
+// Write the specified blocks of data, one after the other, into the file with the specified name in the open
+// folder theDirFD; the name is looked up just once (or twice, when replacing the file atomically).
+//
+// Opening with O_TRUNC replaces the contents of an existing file, so there's no need to delete it first or to set
+// its length afterwards. When replacing the file atomically, the data goes into a temporary file in the same folder,
+// which is then renamed over the file (rename is atomic in POSIX).
+//
+// Under kShortcutFlushAtEndOfBatch and kShortcutFlushPerFolder, the file is left open in thePending (if it isn't
+// NULL), to be flushed by QTShortCut_FlushPendingFiles; if thePending is already full, its files are flushed first.
+//
+//////////
+
+static OSErr QTShortCut_WriteDataAt (int theDirFD, const char *theName, Ptr theBlocks[], long theSizes[], long theNumBlocks, short theFlushPolicy, QTShortCutPendingFilesPtr thePending)
+{
+	static char		myHexDigits[] = "0123456789ABCDEF";
+	Boolean			myAtomic = ((gWriteFlags & kShortcutWriteAtomicReplace) != 0);
+	const char		*myName = theName;
+	char			myTempName[NAME_MAX + 1];
+	const char		*myOpenName = theName;
+	int				myFD = -1;
+	long			myIndex;
+	long			myOffset = 0L;
+	long			myDone;
+	ssize_t			mySize;
+	unsigned long	myStart;
+	OSErr			myErr = noErr;
+	
+	myStart = QTShortCut_StartPhase();
+	
+	// the temporary file's name is the file's name with a tilde and a four-digit hexadecimal count added; it's
+	// created with O_EXCL, so that a file that already has the name (a user's file, say) is never overwritten
+	if (myAtomic) {
+		size_t			myBaseLength = strlen(myName);
+		long			myTries;
+		
+		if (myBaseLength > NAME_MAX - 5)
+			return(bdNamErr);
+		
+		BlockMoveData(myName, myTempName, myBaseLength);
+		myOpenName = myTempName;
+		
+		for (myTries = 0; (myTries <= 0xffff) && (myFD < 0); myTries++) {
+			unsigned short	myCount = gTempFileCount++;
+			size_t			myLength = myBaseLength;
+			
+			myTempName[myLength++] = '~';
+			for (myIndex = 3; myIndex >= 0; myIndex--)
+				myTempName[myLength++] = myHexDigits[(myCount >> (4 * myIndex)) & 0x0f];
+			myTempName[myLength] = '\0';
+			
+			myFD = openat(theDirFD, myTempName, O_WRONLY | O_CREAT | O_EXCL, 0644);
+			if ((myFD < 0) && (errno != EEXIST))
+				break;
+		}
+	} else {
+		myFD = openat(theDirFD, myOpenName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	
+	QTShortCut_EndPhase(kShortcutPhaseOpen, myStart);
+	
+	if (myFD < 0)
+		return(QTShortCut_GetErrnoError(errno));
+	
+	// write the blocks at their offsets in the file, picking up where a short write left off
+	myStart = QTShortCut_StartPhase();
+	
+	for (myIndex = 0; (myIndex < theNumBlocks) && (myErr == noErr); myIndex++) {
+		for (myDone = 0; (myDone < theSizes[myIndex]) && (myErr == noErr); myDone += mySize) {
+			mySize = pwrite(myFD, theBlocks[myIndex] + myDone, theSizes[myIndex] - myDone, myOffset + myDone);
+			if (mySize < 0) {
+				mySize = 0;
+				if (errno != EINTR)
+					myErr = QTShortCut_GetErrnoError(errno);
+			} else if (mySize == 0) {
+				myErr = ioErr;
+			}
+		}
+		
+		myOffset += theSizes[myIndex];
+	}
+	
+	QTShortCut_EndPhase(kShortcutPhaseWrite, myStart);
+	
+	if ((myErr == noErr) && ((theFlushPolicy == kShortcutFlushPerFile) || (theFlushPolicy == kShortcutFlushVolumePerFile))) {
+		myStart = QTShortCut_StartPhase();
+		if (fsync(myFD) != 0)
+			myErr = QTShortCut_GetErrnoError(errno);
+		QTShortCut_EndPhase(kShortcutPhaseFlushFile, myStart);
+	}
+	
+	// keep the file open if its flushing is put off until the batch is flushed
+	if ((myErr == noErr) && (thePending != NULL) && ((theFlushPolicy == kShortcutFlushAtEndOfBatch) || (theFlushPolicy == kShortcutFlushPerFolder))) {
+		if (thePending->fNumFiles == kShortcutMaxPendingFiles)
+			thePending->fErr = QTShortCut_FlushPendingFiles(thePending, theDirFD);
+		
+		thePending->fFiles[thePending->fNumFiles++] = myFD;
+	} else {
+		myStart = QTShortCut_StartPhase();
+		if ((close(myFD) != 0) && (myErr == noErr))
+			myErr = QTShortCut_GetErrnoError(errno);
+		QTShortCut_EndPhase(kShortcutPhaseClose, myStart);
+	}
+	
+	// move the temporary file into place; if anything went wrong, the existing file is left untouched
+	if (myAtomic) {
+		myStart = QTShortCut_StartPhase();
+		if ((myErr == noErr) && (renameat(theDirFD, myTempName, theDirFD, myName) != 0))
+			myErr = QTShortCut_GetErrnoError(errno);
+		if (myErr != noErr)
+			unlinkat(theDirFD, myTempName, 0);
+		QTShortCut_EndPhase(kShortcutPhaseReplace, myStart);
+	}
+	
+	// make the folder's entry for the file durable too
+	if ((myErr == noErr) && (theFlushPolicy == kShortcutFlushVolumePerFile)) {
+		myStart = QTShortCut_StartPhase();
+		if (fsync(theDirFD) != 0)
+			myErr = QTShortCut_GetErrnoError(errno);
+		QTShortCut_EndPhase(kShortcutPhaseFlushVolume, myStart);
+	}
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_FlushPendingFiles
+// Flush and close each of the files that were left open in the specified list, and then flush the folder they were
+// written to, so that its entries for them are durable too; the function result is the first error encountered,
+// including any from flushing the list early.
+//
+//////////
+
+static OSErr QTShortCut_FlushPendingFiles (QTShortCutPendingFilesPtr thePending, int theDirFD)
+{
+	short			myIndex;
+	unsigned long	myStart;
+	OSErr			myErr = thePending->fErr;
+	
+	if (thePending->fNumFiles == 0) {
+		thePending->fErr = noErr;
+		return(myErr);
+	}
+	
+	myStart = QTShortCut_StartPhase();
+	for (myIndex = 0; myIndex < thePending->fNumFiles; myIndex++) {
+		if ((fsync(thePending->fFiles[myIndex]) != 0) && (myErr == noErr))
+			myErr = QTShortCut_GetErrnoError(errno);
+		if ((close(thePending->fFiles[myIndex]) != 0) && (myErr == noErr))
+			myErr = QTShortCut_GetErrnoError(errno);
+	}
+	QTShortCut_EndPhase(kShortcutPhaseFlushFile, myStart);
+	
+	myStart = QTShortCut_StartPhase();
+	if ((theDirFD >= 0) && (fsync(theDirFD) != 0) && (myErr == noErr))
+		myErr = QTShortCut_GetErrnoError(errno);
+	QTShortCut_EndPhase(kShortcutPhaseFlushVolume, myStart);
+	
+	thePending->fNumFiles = 0;
+	thePending->fErr = noErr;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_OpenPathFolder
+// Make sure that the folder containing the file at the specified POSIX path is the one open in gDirFD, and return
+// the part of the path that names the file within it; theChanged is set to true if a different folder was opened.
+// Any files still waiting to be flushed in the folder that was open are flushed before it's closed.
+//
+//////////
+
+static OSErr QTShortCut_OpenPathFolder (const char *thePath, const char **theName, Boolean *theChanged)
+{
+	const char		*mySlash = strrchr(thePath, '/');
+	char			myDirPath[PATH_MAX];
+	size_t			myLength;
+	int				myFD;
+	int				myFlags = O_RDONLY;
+	
+	*theChanged = false;
+	
+	// the folder is everything up to the last slash, or the current directory if there's no slash
+	if (mySlash == NULL) {
+		myLength = 1;
+		myDirPath[0] = '.';
+		*theName = thePath;
+	} else {
+		myLength = (mySlash == thePath) ? 1 : mySlash - thePath;
+		if (myLength >= PATH_MAX)
+			return(bdNamErr);
+		BlockMoveData(thePath, myDirPath, myLength);
+		*theName = mySlash + 1;
+	}
+	
+	myDirPath[myLength] = '\0';
+	
+	if ((*theName)[0] == '\0')
+		return(bdNamErr);
+	
+	if ((gDirFD >= 0) && (strcmp(myDirPath, gDirPath) == 0))
+		return(noErr);
+	
+#ifdef O_DIRECTORY
+	myFlags |= O_DIRECTORY;
+#endif
+	myFD = open(myDirPath, myFlags);
+	if (myFD < 0)
+		return((errno == ENOENT) ? dirNFErr : QTShortCut_GetErrnoError(errno));
+	
+	if (gDirFD >= 0) {
+		gPendingFiles.fErr = QTShortCut_FlushPendingFiles(&gPendingFiles, gDirFD);
+		close(gDirFD);
+	}
+	
+	gDirFD = myFD;
+	BlockMoveData(myDirPath, gDirPath, myLength + 1);
+	*theChanged = true;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_GetErrnoError
+// Return the File Manager result code that's closest to the specified POSIX error number.
+//
+//////////
+
+static OSErr QTShortCut_GetErrnoError (int theErrno)
+{
+	switch (theErrno) {
+		case ENOENT:		return(fnfErr);
+		case ENOTDIR:		return(dirNFErr);
+		case EACCES:
+		case EPERM:			return(permErr);
+		case EROFS:			return(wPrErr);
+		case ENOSPC:		return(dskFulErr);
+		case ENAMETOOLONG:	return(bdNamErr);
+		case EEXIST:		return(dupFNErr);
+		case EMFILE:
+		case ENFILE:		return(tmfoErr);
+		case EISDIR:		return(notAFileErr);
+		case ENOMEM:		return(memFullErr);
+		default:			return(ioErr);
+	}
+}
+#endif	// POSIX_SHORTCUTS
+
+
+//////////
+//
+// QTShortCut_ParseShortcutData
+// Find the data reference in the specified shortcut movie file data, which must consist of exactly the atoms
+// that QTShortCut_CreateShortcutMovieFile writes: a movie atom containing a single movie data reference alias
+// atom containing a single data reference atom.
+//
+// On success, theDataRefType receives the type of the data reference, and theDataRefPtr and theDataRefSize
+// receive the address and size of the data reference within the specified data; nothing is copied or allocated,
+// so the data reference is valid only as long as the specified data is. If the data isn't laid out exactly
+// as expected, the function result is invalidAtomErr.
+//
+//////////
+
+OSErr QTShortCut_ParseShortcutData (Ptr theData, long theSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize)
+{
+	OSType				myAtomTypes[3];
+	OSType				myAtomType;
+	long				myAtomSize;
+	long				myHeaderSize;
+	long				myOffset = 0L;
+	short				myIndex;
+	
+	if ((theData == NULL) || (theDataRefType == NULL) || (theDataRefPtr == NULL) || (theDataRefSize == NULL))
+		return(paramErr);
+
+	if (theSize < (long)kShortcutHeaderSize)
+		return(invalidAtomErr);
+	
+	// check the size and type fields of the three atoms; each atom must fill the rest of the atom that contains it
+	// (any of them may have an extended size, as written by QTShortCut_CreateShortcutMovieFileFromStream)
+	myAtomTypes[0] = MovieAID;
+	myAtomTypes[1] = MovieDataRefAliasAID;
+	myAtomTypes[2] = DataRefAID;
+	
+	for (myIndex = 0; myIndex < 3; myIndex++) {
+		if (!QTShortCut_GetAtomHeader(theData, theSize, myOffset, &myAtomSize, &myAtomType, &myHeaderSize) ||
+			(myAtomType != myAtomTypes[myIndex]) || (myOffset + myAtomSize != theSize))
+			return(invalidAtomErr);
+		
+		myOffset += myHeaderSize;
+	}
+	
+	if (theSize - myOffset < kShortcutFieldSize)
+		return(invalidAtomErr);
+	
+	*theDataRefType = QTShortCut_GetBigEndianLong(theData + myOffset);
+	*theDataRefPtr = theData + myOffset + kShortcutFieldSize;
+	*theDataRefSize = theSize - (myOffset + kShortcutFieldSize);
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_ReadShortcutMovieFile
+// Read the specified shortcut movie file into the specified buffer (with a single read) and find its data reference,
+// as QTShortCut_ParseShortcutData does; the data reference points into the buffer, and no memory is allocated.
+//
+// If the file is larger than the buffer, the function result is paramErr.
+//
+//////////
+
+OSErr QTShortCut_ReadShortcutMovieFile (FSSpecPtr theFSSpecPtr, Ptr theBuffer, long theBufferSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize)
+{
+	short			myRefNum = 0;
+	long			mySize = 0;
+	OSErr			myErr = noErr;
+
+	if ((theFSSpecPtr == NULL) || (theBuffer == NULL))
+		return(paramErr);
+	
+	myErr = FSpOpenDF(theFSSpecPtr, fsRdPerm, &myRefNum);
+	if (myErr != noErr)
+		return(myErr);
+
+	myErr = GetEOF(myRefNum, &mySize);
+	
+	if ((myErr == noErr) && (mySize > theBufferSize))
+		myErr = paramErr;
+
+	if (myErr == noErr)
+		myErr = FSRead(myRefNum, &mySize, theBuffer);
+	
+	FSClose(myRefNum);
+
+	if (myErr == noErr)
+		myErr = QTShortCut_ParseShortcutData(theBuffer, mySize, theDataRefType, theDataRefPtr, theDataRefSize);
+
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_ResolveShortcutMovieFile
+// Get the data reference in the specified shortcut movie file, and its type; theDataRef is resized to hold
+// a copy of the data reference (the caller owns the handle).
+//
+// The data references of the most recently resolved shortcuts are kept in memory, so resolving a shortcut
+// again costs just a catalog lookup, to make sure that the file still has the same file ID and modification
+// date; the file itself is read only if it has changed (or hasn't been resolved recently). Shortcuts written
+// by this code are dropped from the cache as soon as they're written; if a shortcut might be changed by someone
+// else within the resolution of the modification date (one second), call QTShortCut_InvalidateShortcutCache.
+//
+//////////
+
+OSErr QTShortCut_ResolveShortcutMovieFile (FSSpecPtr theFSSpecPtr, OSType *theDataRefType, Handle theDataRef)
+{
+	QTShortCutCacheEntryPtr		myEntry = NULL;
+	long						myFileID;
+	unsigned long				myModDate;
+	long						mySize;
+	Ptr							myDataRefPtr;
+	long						myDataRefSize;
+	short						myIndex;
+	OSErr						myErr = noErr;
+
+	if ((theFSSpecPtr == NULL) || (theDataRefType == NULL) || (theDataRef == NULL))
+		return(paramErr);
+	
+	myErr = QTShortCut_GetFileStamp(theFSSpecPtr, &myFileID, &myModDate, &mySize);
+	if (myErr != noErr) {
+		QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+		return(myErr);
+	}
+	
+	// look for the file in the cache; if it isn't there, use an unused entry or else the least recently used one
+	for (myIndex = 0; myIndex < kShortcutCacheSize; myIndex++) {
+		QTShortCutCacheEntryPtr		myCandidate = &gShortcutCache[myIndex];
+		
+		if (myCandidate->fValid && QTShortCut_IsSameFile(&myCandidate->fFSSpec, theFSSpecPtr)) {
+			myEntry = myCandidate;
+			break;
+		}
+		
+		if ((myEntry == NULL) || (myEntry->fValid && (!myCandidate->fValid || (myCandidate->fLastUsed < myEntry->fLastUsed))))
+			myEntry = myCandidate;
+	}
+	
+	myEntry->fLastUsed = ++gShortcutCacheClock;
+	
+	if (!myEntry->fValid || !QTShortCut_IsSameFile(&myEntry->fFSSpec, theFSSpecPtr) || (myEntry->fFileID != myFileID) || (myEntry->fModDate != myModDate)) {
+		// the file isn't in the cache, or it has changed since we read it; read it now, straight into the entry's
+		// handle (which is reused from whatever the entry held before), and then move the data reference down to
+		// the beginning of the handle
+		myEntry->fValid = false;
+		
+		if (myEntry->fDataRef == NULL)
+			myEntry->fDataRef = NewHandle(mySize);
+		else
+			SetHandleSize(myEntry->fDataRef, mySize);
+		
+		myErr = MemError();
+		if ((myErr == noErr) && (myEntry->fDataRef == NULL))
+			myErr = memFullErr;
+		
+		if (myErr == noErr) {
+			HLock(myEntry->fDataRef);
+			myErr = QTShortCut_ReadShortcutMovieFile(theFSSpecPtr, *myEntry->fDataRef, mySize, &myEntry->fDataRefType, &myDataRefPtr, &myDataRefSize);
+			if (myErr == noErr)
+				BlockMoveData(myDataRefPtr, *myEntry->fDataRef, myDataRefSize);
+			HUnlock(myEntry->fDataRef);
+		}
+		
+		if (myErr == noErr)
+			SetHandleSize(myEntry->fDataRef, myDataRefSize);
+	
+		if (myErr != noErr)
+			return(myErr);
+		
+		myEntry->fValid = true;
+		myEntry->fFSSpec = *theFSSpecPtr;
+		myEntry->fFileID = myFileID;
+		myEntry->fModDate = myModDate;
+	}
+	
+	// give the caller a copy of the data reference
+	myDataRefSize = GetHandleSize(myEntry->fDataRef);
+	SetHandleSize(theDataRef, myDataRefSize);
+	myErr = MemError();
+	if (myErr == noErr) {
+		BlockMoveData(*myEntry->fDataRef, *theDataRef, myDataRefSize);
+		*theDataRefType = myEntry->fDataRefType;
+	}
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_InvalidateShortcutCache
+// Forget what QTShortCut_ResolveShortcutMovieFile remembers about the specified shortcut movie file, so that
+// the next call to resolve it reads the file again; if theFSSpecPtr is NULL, forget about all shortcut files.
+//
+// The memory that held the data references is kept for reuse; call QTShortCut_ReleaseScratchMemory to free it.
+//
+//////////
+
+void QTShortCut_InvalidateShortcutCache (FSSpecPtr theFSSpecPtr)
+{
+	short			myIndex;
+	
+	for (myIndex = 0; myIndex < kShortcutCacheSize; myIndex++) {
+		QTShortCutCacheEntryPtr		myEntry = &gShortcutCache[myIndex];
+		
+		if (myEntry->fValid && ((theFSSpecPtr == NULL) || QTShortCut_IsSameFile(&myEntry->fFSSpec, theFSSpecPtr)))
+			myEntry->fValid = false;
+	}
+}
+
+
+//////////
+//
+// QTShortCut_ReleaseScratchMemory
+// Free the memory that's kept around to be reused from one file to the next: the scratch block used to assemble
+// reference movies and shortcut packs, and the handles of unused cache entries. If the POSIX file functions are
+// compiled in, the folder that they keep open is closed too.
+//
+// Generating files never needs to allocate memory once this memory has grown to fit the largest file so far, so a
+// long-running generator keeps clear of the Memory Manager (and of heap fragmentation); call this function when
+// a batch is done, or when memory is tight.
+//
+//////////
+
+void QTShortCut_ReleaseScratchMemory (void)
+{
+	short			myIndex;
+	
+	if (gScratch != NULL)
+		DisposePtr(gScratch);
+	gScratch = NULL;
+	gScratchSize = 0L;
+	
+#if POSIX_SHORTCUTS
+	if (gDirFD >= 0) {
+		QTShortCut_FlushPendingFiles(&gPendingFiles, gDirFD);
+		close(gDirFD);
+	}
+	gDirFD = -1;
+#endif	// POSIX_SHORTCUTS
+	
+	for (myIndex = 0; myIndex < kShortcutCacheSize; myIndex++) {
+		QTShortCutCacheEntryPtr		myEntry = &gShortcutCache[myIndex];
+		
+		if (!myEntry->fValid && (myEntry->fDataRef != NULL)) {
+			DisposeHandle(myEntry->fDataRef);
+			myEntry->fDataRef = NULL;
+		}
+	}
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutPackFile
+// Create a shortcut pack file holding a batch of shortcuts; the i-th shortcut is named theNames[i] and refers to
+// the data reference theDataRefs[i], of type theDataRefTypes[i].
+//
+// A pack file holds many shortcuts in a single file. It starts with a header (all fields are big-endian longs):
+//
+//		'qtsp', format version, number of shortcuts, offset of the index
+//
+// followed by the shortcuts' movie atoms, back to back, each exactly as QTShortCut_CreateShortcutMovieFile
+// would write it into a file of its own. Then comes the index, one entry per shortcut, sorted by name:
+//
+//		offset of the name, offset of the movie atom, size of the movie atom
+//
+// and finally the names, as Pascal strings, in the same order as the index. All offsets are from the start of the
+// file, so a pack can be read into memory (or mapped) and searched without any further preparation; see
+// QTShortCut_FindInShortcutPack. Names are compared byte by byte, and no two shortcuts may have the same name.
+// A name may not contain a colon, since QTShortCut_ExtractShortcutPack would take it as a partial pathname.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutPackFile (Handle theDataRefs[], OSType theDataRefTypes[], StringPtr theNames[], long theCount, FSSpecPtr theFSSpecPtr)
+{
+	Ptr				myBuffer = NULL;
+	Ptr *			myBlocks;
+	long *			mySizes;
+	long *			myOrder;
+	long *			myOffsets;
+	Ptr				myHeaders;
+	Ptr				myIndexPtr;
+	Ptr				myNamesPtr;
+	Ptr				myNamePtr;
+	SignedByte *	myStates;
+	long			myNumBlocks = (2 * theCount) + 3;
+	long			myNamesSize = 0L;
+	long			myTotalSize = kShortcutPackHeaderSize;
+	long			myOffset;
+	long			myNameOffset;
+	long			myIndex;
+	FInfo			myFInfo;
+	OSErr			myErr = noErr;
+	
+	if ((theDataRefs == NULL) || (theDataRefTypes == NULL) || (theNames == NULL) || (theFSSpecPtr == NULL) || (theCount < 0))
+		return(paramErr);
+	
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		if ((theDataRefs[myIndex] == NULL) || (theNames[myIndex] == NULL) || (theNames[myIndex][0] == 0))
+			return(paramErr);
+		if (!QTShortCut_IsLeafName(theNames[myIndex]))
+			return(bdNamErr);
+		myNamesSize += theNames[myIndex][0] + 1;
+		
+		// the pack's offsets are 32-bit, and the whole pack must fit in a file the File Manager can write
+		if (!QTShortCut_AddSize(&myTotalSize, kShortcutHeaderSize + kShortcutPackIndexEntrySize + theNames[myIndex][0] + 1) ||
+			!QTShortCut_AddSize(&myTotalSize, GetHandleSize(theDataRefs[myIndex])))
+			return(paramErr);
+	}
+	
+	// get room for the list of blocks to write, the sort order, the offsets of the movie atoms, the pack header,
+	// the movie atom headers, the index, the names, and the saved handle states all at once
+	myBuffer = QTShortCut_GetScratch((myNumBlocks * (sizeof(Ptr) + sizeof(long))) + (2 * theCount * sizeof(long)) + kShortcutPackHeaderSize +
+									 (theCount * (kShortcutHeaderSize + kShortcutPackIndexEntrySize)) + myNamesSize + theCount);
+	if (myBuffer == NULL)
+		return(memFullErr);
+	
+	myBlocks = (Ptr *)myBuffer;
+	mySizes = (long *)(myBlocks + myNumBlocks);
+	myOrder = mySizes + myNumBlocks;
+	myOffsets = myOrder + theCount;
+	myHeaders = (Ptr)(myOffsets + theCount);
+	myIndexPtr = myHeaders + kShortcutPackHeaderSize + (theCount * kShortcutHeaderSize);
+	myNamesPtr = myIndexPtr + (theCount * kShortcutPackIndexEntrySize);
+	myStates = (SignedByte *)(myNamesPtr + myNamesSize);
+	
+	// sort the names, and make sure they're all different
+	for (myIndex = 0; myIndex < theCount; myIndex++)
+		myOrder[myIndex] = myIndex;
+	
+	QTShortCut_SortNames(theNames, myOrder, theCount);
+	
+	for (myIndex = 1; myIndex < theCount; myIndex++)
+		if (QTShortCut_CompareNames(theNames[myOrder[myIndex - 1]], theNames[myOrder[myIndex]]) == 0) {
+			myErr = dupFNErr;
+			goto bail;
+		}
+	
+	// the movie atoms, in the order given; each is a header followed by the data reference, written from its handle
+	myBlocks[0] = myHeaders;
+	mySizes[0] = kShortcutPackHeaderSize;
+	myOffset = kShortcutPackHeaderSize;
+	
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		Handle		myDataRef = theDataRefs[myIndex];
+		Ptr			myHeader = myHeaders + kShortcutPackHeaderSize + (myIndex * kShortcutHeaderSize);
+		
+		QTShortCut_FillShortcutHeader(GetHandleSize(myDataRef), theDataRefTypes[myIndex], myHeader);
+		
+		myStates[myIndex] = HGetState(myDataRef);
+		HLock(myDataRef);
+		
+		myBlocks[(2 * myIndex) + 1] = myHeader;
+		mySizes[(2 * myIndex) + 1] = kShortcutHeaderSize;
+		myBlocks[(2 * myIndex) + 2] = *myDataRef;
+		mySizes[(2 * myIndex) + 2] = GetHandleSize(myDataRef);
+		
+		myOffsets[myIndex] = myOffset;
+		myOffset += kShortcutHeaderSize + GetHandleSize(myDataRef);
+	}
+	
+	// the pack header
+	QTShortCut_PutBigEndianLong(myHeaders, kShortcutPackMagic);
+	QTShortCut_PutBigEndianLong(myHeaders + (1 * kShortcutFieldSize), kShortcutPackVersion);
+	QTShortCut_PutBigEndianLong(myHeaders + (2 * kShortcutFieldSize), theCount);
+	QTShortCut_PutBigEndianLong(myHeaders + (3 * kShortcutFieldSize), myOffset);
+	
+	// the index and the names, in sorted order
+	myNameOffset = myOffset + (theCount * kShortcutPackIndexEntrySize);
+	myNamePtr = myNamesPtr;
+	
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		long		myItem = myOrder[myIndex];
+		StringPtr	myName = theNames[myItem];
+		Ptr			myEntry = myIndexPtr + (myIndex * kShortcutPackIndexEntrySize);
+		
+		myEntry = QTShortCut_PutBigEndianLong(myEntry, myNameOffset);
+		myEntry = QTShortCut_PutBigEndianLong(myEntry, myOffsets[myItem]);
+		myEntry = QTShortCut_PutBigEndianLong(myEntry, kShortcutHeaderSize + GetHandleSize(theDataRefs[myItem]));
+		
+		BlockMoveData(myName, myNamePtr, myName[0] + 1);
+		myNamePtr += myName[0] + 1;
+		myNameOffset += myName[0] + 1;
+	}
+	
+	myBlocks[myNumBlocks - 2] = myIndexPtr;
+	mySizes[myNumBlocks - 2] = theCount * kShortcutPackIndexEntrySize;
+	myBlocks[myNumBlocks - 1] = myNamesPtr;
+	mySizes[myNumBlocks - 1] = myNamesSize;
+	
+	myErr = QTShortCut_WriteDataToFile(myBlocks, mySizes, myNumBlocks, theFSSpecPtr, kShortcutFlushVolumePerFile);
+	
+	// restore the states in the reverse order, so that a data reference used by more than one entry gets back the
+	// state it had before the first of them locked it
+	for (myIndex = theCount - 1; myIndex >= 0; myIndex--)
+		HSetState(theDataRefs[myIndex], myStates[myIndex]);
+	
+	// a pack file isn't a movie file
+	if (myErr == noErr)
+		myErr = FSpGetFInfo(theFSSpecPtr, &myFInfo);
+	
+	if (myErr == noErr) {
+		myFInfo.fdType = kShortcutPackFileType;
+		myErr = FSpSetFInfo(theFSSpecPtr, &myFInfo);
+	}
+
+bail:
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_FindInShortcutPack
+// Find the shortcut with the specified name in the specified shortcut pack file data (the contents of a file
+// written by QTShortCut_CreateShortcutPackFile), using a binary search of its index.
+//
+// On success, theShortcutPtr and theShortcutSize receive the address and size of the shortcut's movie atom within
+// the pack data; this is exactly the data of a shortcut movie file, and can be passed to QTShortCut_ParseShortcutData.
+// Nothing is copied or allocated. If there's no such shortcut, the function result is fnfErr; if the pack data is
+// malformed, it is invalidAtomErr.
+//
+//////////
+
+OSErr QTShortCut_FindInShortcutPack (Ptr thePack, long thePackSize, ConstStr255Param theName, Ptr *theShortcutPtr, long *theShortcutSize)
+{
+	Ptr				myIndex;
+	StringPtr		myName;
+	long			myCount;
+	long			myLow, myHigh, myMiddle;
+	short			myOrder;
+	OSErr			myErr = noErr;
+	
+	if ((thePack == NULL) || (theName == NULL) || (theShortcutPtr == NULL) || (theShortcutSize == NULL))
+		return(paramErr);
+	
+	myErr = QTShortCut_GetPackIndex(thePack, thePackSize, &myCount, &myIndex);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myLow = 0;
+	myHigh = myCount;
+	while (myLow < myHigh) {
+		myMiddle = myLow + ((myHigh - myLow) / 2);
+		
+		if (!QTShortCut_GetPackEntry(thePack, thePackSize, myIndex, myMiddle, &myName, theShortcutPtr, theShortcutSize))
+			return(invalidAtomErr);
+		
+		myOrder = QTShortCut_CompareNames(theName, myName);
+		if (myOrder == 0)
+			return(noErr);
+		
+		if (myOrder < 0)
+			myHigh = myMiddle;
+		else
+			myLow = myMiddle + 1;
+	}
+	
+	return(fnfErr);
+}
+
+
+//////////
+//
+// QTShortCut_ExtractShortcutPack
+// Write each shortcut in the specified shortcut pack file data into a shortcut movie file of its own, with the same
+// name, in the specified folder; each file is byte for byte the file that QTShortCut_CreateShortcutMovieFile writes.
+//
+// A failure on one file does not stop the extraction; the function result is the first error encountered, and
+// theNumExtracted (if not NULL) receives the number of files written. The volume is flushed once, at the end.
+//
+//////////
+
+OSErr QTShortCut_ExtractShortcutPack (Ptr thePack, long thePackSize, short theVRefNum, long theDirID, long *theNumExtracted)
+{
+	FSSpec			myFSSpec;
+	Ptr				myIndex;
+	StringPtr		myName;
+	Ptr				myShortcutPtr;
+	long			myShortcutSize;
+	long			myCount;
+	long			myEntry;
+	OSErr			myItemErr = noErr;
+	OSErr			myErr = noErr;
+	
+	if (theNumExtracted != NULL)
+		*theNumExtracted = 0L;
+	
+	if (thePack == NULL)
+		return(paramErr);
+	
+	myErr = QTShortCut_GetPackIndex(thePack, thePackSize, &myCount, &myIndex);
+	if (myErr != noErr)
+		return(myErr);
+	
+	for (myEntry = 0; myEntry < myCount; myEntry++) {
+		if (!QTShortCut_GetPackEntry(thePack, thePackSize, myIndex, myEntry, &myName, &myShortcutPtr, &myShortcutSize)) {
+			myItemErr = invalidAtomErr;
+		} else {
+			// if the file doesn't exist yet, we'll get an error (fnfErr), but the FSSpec is still good
+			myItemErr = FSMakeFSSpec(theVRefNum, theDirID, myName, &myFSSpec);
+			if (myItemErr == fnfErr)
+				myItemErr = noErr;
+			
+			if (myItemErr == noErr)
+				myItemErr = QTShortCut_WriteDataToFile(&myShortcutPtr, &myShortcutSize, 1, &myFSSpec, kShortcutFlushNone);
+		}
+		
+		if ((myItemErr == noErr) && (theNumExtracted != NULL))
+			(*theNumExtracted)++;
+		
+		if ((myErr == noErr) && (myItemErr != noErr))
+			myErr = myItemErr;
+	}
+	
+#if TARGET_OS_MAC	
+	myItemErr = FlushVol(NULL, theVRefNum);
+	if (myErr == noErr)
+		myErr = myItemErr;
+#endif	// TARGET_OS_MAC	
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_RetargetShortcuts
+// Give new targets to the shortcut movie files in the specified folder and all the folders inside it, by rewriting
+// the beginning of their data references according to the specified rules; the first rule that matches a data
+// reference is applied, and a shortcut that no rule matches is left alone.
+//
+// Only the files that change are written. If the new data reference is the same size as the old one, it's simply
+// written over the old one, in place; so is a URL that gets shorter, padded out with zero bytes (a URL data reference
+// is a C string, so the padding is ignored). Otherwise, the shortcut is rewritten to a temporary file that then
+// replaces the old one atomically (see QTShortCut_SetWriteFlags). The volume is flushed once, at the end.
+//
+// If theStats is not NULL, it receives counts of what was done and the time it took. Failures on individual files
+// are counted but don't stop the scan; the function result is an error only if the scan itself couldn't be completed.
+// Movie files larger than kShortcutMaxScanSize are taken not to be shortcuts, and are skipped without being read.
+//
+// The rules are plain prefixes; there's no regular expression library in the Toolbox, and prefixes cover the usual
+// case of a server or a folder moving.
+//
+//////////
+
+OSErr QTShortCut_RetargetShortcuts (short theVRefNum, long theDirID, QTShortCutRetargetRule theRules[], short theNumRules, QTShortCutRetargetStatsPtr theStats)
+{
+	QTShortCutRetargetState		myState;
+	QTShortCutRetargetStats		myStats;
+	unsigned long				myStartTicks = TickCount();
+#if TARGET_OS_MAC	
+	OSErr						myFlushErr = noErr;
+#endif	// TARGET_OS_MAC	
+	OSErr						myErr = noErr;
+	
+	if ((theRules == NULL) || (theNumRules <= 0))
+		return(paramErr);
+	
+	BlockZero(&myStats, sizeof(myStats));
+	
+	myState.fRules = theRules;
+	myState.fNumRules = theNumRules;
+	myState.fStats = &myStats;
+	myState.fFileData = NewHandle(0);
+	myState.fDataRef = NewHandle(0);
+	
+	if ((myState.fFileData == NULL) || (myState.fDataRef == NULL))
+		myErr = memFullErr;
+	
+	if (myErr == noErr)
+		myErr = QTShortCut_ScanFolder(theVRefNum, theDirID, QTShortCut_RetargetFile, &myState);
+	
+#if TARGET_OS_MAC	
+	if (myStats.fNumChanged > 0)
+		myFlushErr = FlushVol(NULL, theVRefNum);
+	if (myErr == noErr)
+		myErr = myFlushErr;
+#endif	// TARGET_OS_MAC	
+	
+	if (myState.fFileData != NULL)
+		DisposeHandle(myState.fFileData);
+	if (myState.fDataRef != NULL)
+		DisposeHandle(myState.fDataRef);
+	
+	myStats.fTicks = TickCount() - myStartTicks;
+	if (theStats != NULL)
+		*theStats = myStats;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutsFromManifest
+// Create the shortcut movie files listed in a manifest, whose contents are supplied piece by piece by theReadProc
+// (for instance, from a file or from standard input). Each record in the manifest names a file, relative to the
+// specified folder (a partial pathname such as ":Movies:Clip" may be used), and gives the target of the shortcut.
+//
+// In kShortcutManifestLines format, each line holds the file name, a tab, the four-character data reference type,
+// a tab, and the data reference; the line can end in CR LF or LF, and blank lines are ignored. The terminating zero
+// byte that QuickTime expects at the end of a URL data reference is added for you. In kShortcutManifestBinary
+// format, each record is a length byte and the file name, the data reference type, and the big-endian 32-bit size
+// of the data reference followed by the data reference; this format can carry any type of data reference.
+//
+// The manifest is read through a fixed buffer of kShortcutManifestBufferSize bytes, and the records are written in
+// batches of kShortcutManifestBatchSize (with QTShortCut_CreateShortcutMovieFilesAsync, keeping theMaxInFlight files
+// being written at once, if theMaxInFlight is greater than 1; otherwise with QTShortCut_CreateShortcutMovieFiles).
+// So the memory used is the same however long the manifest is. A record larger than the buffer is skipped.
+//
+// If theStats is not NULL, it receives counts of what was done and the time it took. Malformed records and files
+// that can't be written are counted but don't stop the manifest; the function result is an error only if the
+// manifest couldn't be read.
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutsFromManifest (QTShortCutReadProcPtr theReadProc, void *theRefCon, short theFormat, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutManifestStatsPtr theStats)
+{
+	QTShortCutManifestBatchPtr	myBatch = NULL;
+	QTShortCutManifestRecord	myRecord;
+	QTShortCutManifestStats		myStats;
+	unsigned long				myStartTicks = TickCount();
+	Ptr							myBuffer = NULL;
+	long						myStart = 0L;				// the unparsed bytes in the buffer are myStart up to myEnd
+	long						myEnd = 0L;
+	long						mySize;
+	long						mySkipSize = 0L;			// the bytes left in a binary record that's too large
+	Boolean						mySkipLine = false;			// true while skipping the rest of a line that's too long
+	Boolean						myAtEnd = false;
+	long						myIndex;
+	OSErr						myErr = noErr;
+	
+	if ((theReadProc == NULL) || ((theFormat != kShortcutManifestLines) && (theFormat != kShortcutManifestBinary)))
+		return(paramErr);
+	
+	BlockZero(&myStats, sizeof(myStats));
+	
+	myBatch = (QTShortCutManifestBatchPtr)NewPtrClear(sizeof(QTShortCutManifestBatch));
+	myBuffer = NewPtr(kShortcutManifestBufferSize);
+	if ((myBatch == NULL) || (myBuffer == NULL)) {
+		myErr = memFullErr;
+		goto bail;
+	}
+	
+	while (true) {
+		// take as many records out of the buffer as it holds
+		while (myStart < myEnd) {
+			if (mySkipSize > 0) {
+				mySize = (mySkipSize < myEnd - myStart) ? mySkipSize : myEnd - myStart;
+				myStart += mySize;
+				mySkipSize -= mySize;
+				continue;
+			}
+			
+			if (mySkipLine) {
+				while ((myStart < myEnd) && (myBuffer[myStart] != '\n'))
+					myStart++;
+				if (myStart < myEnd) {
+					myStart++;
+					mySkipLine = false;
+				}
+				continue;
+			}
+			
+			mySize = QTShortCut_ParseManifestRecord(myBuffer + myStart, myEnd - myStart, theFormat, myAtEnd, &myRecord);
+			if (mySize == 0)
+				break;
+			
+			myStart += mySize;
+			if (myRecord.fKind == kManifestRecordEmpty)
+				continue;
+			
+			myStats.fNumRecords++;
+			if (myRecord.fKind == kManifestRecordMalformed) {
+				myStats.fNumMalformed++;
+				continue;
+			}
+			
+			if (QTShortCut_AddToManifestBatch(myBatch, &myRecord, theFormat, theVRefNum, theDirID) != noErr) {
+				myStats.fNumErrors++;
+				continue;
+			}
+			
+			if (myBatch->fCount == kShortcutManifestBatchSize)
+				QTShortCut_WriteManifestBatch(myBatch, theMaxInFlight, &myStats);
+		}
+		
+		if (myAtEnd)
+			break;
+		
+		// if the buffer is full and still doesn't hold a whole record, the record is too large; skip it
+		if ((myStart == 0) && (myEnd == kShortcutManifestBufferSize)) {
+			myStats.fNumRecords++;
+			myStats.fNumErrors++;
+			
+			if (theFormat == kShortcutManifestLines)
+				mySkipLine = true;
+			else
+				mySkipSize = myRecord.fRecordSize - myEnd;
+			
+			myStart = myEnd = 0L;
+		}
+		
+		// move what's left of the buffer to its beginning, and fill up the rest
+		if (myStart > 0) {
+			BlockMoveData(myBuffer + myStart, myBuffer, myEnd - myStart);
+			myEnd -= myStart;
+			myStart = 0L;
+		}
+		
+		mySize = kShortcutManifestBufferSize - myEnd;
+		myErr = (*theReadProc)(myBuffer + myEnd, &mySize, theRefCon);
+		myEnd += mySize;
+		
+		if ((myErr == eofErr) || ((myErr == noErr) && (mySize == 0))) {
+			myAtEnd = true;
+			myErr = noErr;
+		}
+		
+		if (myErr != noErr)
+			break;
+	}
+	
+	// write whatever is left over from the last batch
+	if (myBatch->fCount > 0)
+		QTShortCut_WriteManifestBatch(myBatch, theMaxInFlight, &myStats);
+	
+bail:
+	if (myBatch != NULL) {
+		for (myIndex = 0; myIndex < kShortcutManifestBatchSize; myIndex++)
+			if (myBatch->fDataRefs[myIndex] != NULL)
+				DisposeHandle(myBatch->fDataRefs[myIndex]);
+		DisposePtr((Ptr)myBatch);
+	}
+	
+	if (myBuffer != NULL)
+		DisposePtr(myBuffer);
+	
+	myStats.fTicks = TickCount() - myStartTicks;
+	if (theStats != NULL)
+		*theStats = myStats;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_CreateShortcutsFromManifestFile
+// Create the shortcut movie files listed in the specified manifest file (see QTShortCut_CreateShortcutsFromManifest).
+//
+//////////
+
+OSErr QTShortCut_CreateShortcutsFromManifestFile (FSSpecPtr theManifestFSSpecPtr, short theFormat, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutManifestStatsPtr theStats)
+{
+	short			myRefNum = 0;
+	OSErr			myErr = noErr;
+	
+	myErr = FSpOpenDF(theManifestFSSpecPtr, fsRdPerm, &myRefNum);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myErr = QTShortCut_CreateShortcutsFromManifest(QTShortCut_ReadManifestFile, &myRefNum, theFormat, theVRefNum, theDirID, theMaxInFlight, theStats);
+	
+	FSClose(myRefNum);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_NewSyncService
+// Create a sync service that keeps the shortcut movie files in the specified folder (and in the folders inside it)
+// pointing at their targets when the targets are renamed or moved.
+//
+// The service keeps a reverse index: for each shortcut whose data reference is an alias, the file that the alias
+// resolves to and the folder that file is in. The Toolbox can't tell us when files are renamed or moved, so the
+// folders in the index are polled instead, by QTShortCut_IdleSyncService; a folder's modification date changes
+// whenever a file in it is renamed, or is moved into or out of it. Only the shortcuts whose targets were in a folder
+// that has changed are looked at again, and only those whose aliases the Alias Manager had to update are rewritten.
+//
+// Shortcuts to URLs and other data references that don't name local files aren't kept in the index, and neither
+// are shortcuts whose targets can't be found when the index is built. To add a shortcut created later (for instance,
+// with QTShortCut_CreateShortcutMovieFile), call QTShortCut_AddToSyncService.
+//
+// On Windows, this function returns unimpErr.
+//
+//////////
+
+OSErr QTShortCut_NewSyncService (short theVRefNum, long theDirID, QTShortCutSyncServicePtr *theService)
+{
+#if TARGET_OS_MAC	
+	QTShortCutSyncServicePtr	myService = NULL;
+	OSErr						myErr = noErr;
+	
+	if (theService == NULL)
+		return(paramErr);
+	
+	*theService = NULL;
+	
+	myService = (QTShortCutSyncServicePtr)NewPtrClear(sizeof(struct QTShortCutSyncService));
+	if (myService == NULL)
+		return(MemError());
+	
+	myService->fEntries = NewHandle(0);
+	myService->fFolders = NewHandle(0);
+	myService->fFileData = NewHandle(0);
+	myService->fAlias = NewHandle(0);
+	
+	if ((myService->fEntries == NULL) || (myService->fFolders == NULL) || (myService->fFileData == NULL) || (myService->fAlias == NULL))
+		myErr = memFullErr;
+	
+	if (myErr == noErr)
+		myErr = QTShortCut_ScanFolder(theVRefNum, theDirID, QTShortCut_IndexSyncShortcut, myService);
+	
+	if (myErr != noErr) {
+		QTShortCut_DisposeSyncService(myService);
+		return(myErr);
+	}
+	
+	*theService = myService;
+	
+	return(noErr);
+#else
+	return(unimpErr);
+#endif	// TARGET_OS_MAC	
+}
+
+
+//////////
+//
+// QTShortCut_AddToSyncService
+// Add the specified shortcut movie file to the index of the specified sync service, or bring its entry up to date
+// if it's already there.
+//
+// If the shortcut's data reference isn't an alias, nothing is added and the function result is noErr; if the
+// shortcut's target can't be found, the function result is the error from the Alias Manager.
+//
+//////////
+
+OSErr QTShortCut_AddToSyncService (QTShortCutSyncServicePtr theService, FSSpecPtr theFSSpecPtr)
+{
+#if TARGET_OS_MAC	
+	FSSpec			myTarget;
+	Boolean			myIsAlias = false;
+	Boolean			myWasChanged = false;
+	OSErr			myErr = noErr;
+	
+	if ((theService == NULL) || (theFSSpecPtr == NULL))
+		return(paramErr);
+	
+	myErr = QTShortCut_ReadSyncAlias(theService, theFSSpecPtr, &myIsAlias);
+	if ((myErr != noErr) || !myIsAlias)
+		return(myErr);
+	
+	myErr = ResolveAliasWithMountFlags(theFSSpecPtr, (AliasHandle)theService->fAlias, &myTarget, &myWasChanged, kResolveAliasFileNoUI);
+	if (myErr != noErr)
+		return(myErr);
+	
+	return(QTShortCut_AddSyncEntry(theService, theFSSpecPtr, &myTarget, true));
+#else
+	return(unimpErr);
+#endif	// TARGET_OS_MAC	
+}
+
+
+//////////
+//
+// QTShortCut_IdleSyncService
+// Poll the folders watched by the specified sync service, and bring up to date the shortcuts whose targets have
+// been renamed or moved since the last call. Call this function from time to time (for instance, when your
+// application gets a null event, or from a thread of its own); a call that finds no changed folders makes
+// one catalog call per folder and touches no files.
+//
+// A shortcut is rewritten (atomically, with the alias as updated by the Alias Manager) only if its target has moved.
+// A shortcut whose target can no longer be found is left as it is and counted as dangling; it's looked at again when
+// its folder changes again, in case the target comes back. Shortcuts that have been deleted, or that no longer hold
+// aliases, are dropped from the index. Since only the folder that holds a target is polled, renaming or moving a
+// folder further up is noticed only when the target's folder itself changes.
+//
+// If theStats is not NULL, it receives counts of what was done in this call and the time it took. Failures on
+// individual shortcuts are counted but don't stop the call; the function result is an error only if the index
+// couldn't be kept up to date.
+//
+//////////
+
+OSErr QTShortCut_IdleSyncService (QTShortCutSyncServicePtr theService, QTShortCutSyncStatsPtr theStats)
+{
+#if TARGET_OS_MAC	
+	QTShortCutSyncStats			myStats;
+	QTShortCutVolumeList		myVolumes;
+	QTShortCutSyncFolderPtr		myFolder;
+	long						myNumFolders;
+	long						myIndex;
+	Boolean						myAnyChanged = false;
+	unsigned long				myStartTicks = TickCount();
+	OSErr						myFlushErr = noErr;
+	OSErr						myErr = noErr;
+	
+	if (theService == NULL)
+		return(paramErr);
+	
+	BlockZero(&myStats, sizeof(myStats));
+	QTShortCut_InitVolumeList(&myVolumes, kShortcutFlushAtEndOfBatch);
+	
+	// poll the folders; folders added below, as targets are found in new places, are up to date already
+	myNumFolders = theService->fNumFolders;
+	for (myIndex = 0; myIndex < myNumFolders; myIndex++) {
+		QTShortCutSyncFolder		myState;
+		
+		myFolder = (QTShortCutSyncFolderPtr)*theService->fFolders + myIndex;
+		QTShortCut_GetSyncFolderState(myFolder->fVRefNum, myFolder->fDirID, &myState);
+		
+		myFolder->fChanged = (myState.fParID != myFolder->fParID) || (myState.fModDate != myFolder->fModDate) ||
+							 !EqualString(myState.fName, myFolder->fName, false, true);
+		if (myFolder->fChanged) {
+			myFolder->fParID = myState.fParID;
+			myFolder->fModDate = myState.fModDate;
+			BlockMoveData(myState.fName, myFolder->fName, myState.fName[0] + 1);
+			myStats.fNumChangedFolders++;
+			myAnyChanged = true;
+		}
+	}
+	
+	// look again at the shortcuts whose targets were in the folders that changed; a shortcut that's dropped from
+	// the index is replaced by the last entry, which is then looked at in its place
+	myIndex = 0;
+	while (myAnyChanged && (myIndex < theService->fNumEntries) && (myErr == noErr)) {
+		long						myFolderIndex = ((QTShortCutSyncEntryPtr)*theService->fEntries)[myIndex].fFolder;
+		Boolean						myDropped = false;
+		
+		if ((myFolderIndex < myNumFolders) && ((QTShortCutSyncFolderPtr)*theService->fFolders)[myFolderIndex].fChanged)
+			myErr = QTShortCut_SyncShortcut(theService, myIndex, &myStats, &myVolumes, &myDropped);
+		
+		if (!myDropped)
+			myIndex++;
+	}
+	
+	for (myIndex = 0; myIndex < myNumFolders; myIndex++)
+		((QTShortCutSyncFolderPtr)*theService->fFolders)[myIndex].fChanged = false;
+	
+	myFlushErr = QTShortCut_FlushVolumes(&myVolumes);
+	if (myErr == noErr)
+		myErr = myFlushErr;
+	
+	myStats.fNumShortcuts = theService->fNumEntries;
+	myStats.fNumFolders = theService->fNumFolders;
+	myStats.fTicks = TickCount() - myStartTicks;
+	if (theStats != NULL)
+		*theStats = myStats;
+	
+	return(myErr);
+#else
+	return(unimpErr);
+#endif	// TARGET_OS_MAC	
+}
+
+
+//////////
+//
+// QTShortCut_DisposeSyncService
+// Dispose of the specified sync service and its index; the shortcut files are left as they are.
+//
+//////////
+
+void QTShortCut_DisposeSyncService (QTShortCutSyncServicePtr theService)
+{
+#if TARGET_OS_MAC	
+	if (theService == NULL)
+		return;
+	
+	if (theService->fEntries != NULL)
+		DisposeHandle(theService->fEntries);
+	if (theService->fFolders != NULL)
+		DisposeHandle(theService->fFolders);
+	if (theService->fFileData != NULL)
+		DisposeHandle(theService->fFileData);
+	if (theService->fAlias != NULL)
+		DisposeHandle(theService->fAlias);
+	
+	DisposePtr((Ptr)theService);
+#endif	// TARGET_OS_MAC	
+}
+
+
+//////////
+//
+// QTShortCut_NewShortcutIndex
+// Create an empty reverse index, which maps the targets of shortcut movie files to the files themselves. Add
+// shortcuts to it with QTShortCut_IndexShortcutFolder and QTShortCut_UpdateShortcutIndex, and find the shortcuts
+// to a given target (or to any target beginning with a given prefix) with QTShortCut_FindInShortcutIndex.
+//
+// The index is kept compact: each shortcut takes a small fixed-size record, and its data reference and file name
+// are stored back to back in a single string pool. The records are reached in two ways: through a list of record
+// numbers sorted by data reference, so that the shortcuts whose data references begin with a given prefix are found
+// with a binary search, and through a hash table keyed on the shortcut file, so that a file that's indexed again
+// replaces its old record. Records added since the last lookup are sorted and merged into the list at the next
+// lookup, and removed records are just marked until they make up half the index; so keeping the index up to date
+// costs little more than reading the files that changed.
+//
+//////////
+
+OSErr QTShortCut_NewShortcutIndex (QTShortCutIndexPtr *theIndex)
+{
+	QTShortCutIndexPtr		myIndex = NULL;
+	
+	if (theIndex == NULL)
+		return(paramErr);
+	
+	*theIndex = NULL;
+	
+	myIndex = (QTShortCutIndexPtr)NewPtrClear(sizeof(struct QTShortCutIndex));
+	if (myIndex == NULL)
+		return(MemError());
+	
+	myIndex->fPool = NewHandle(0);
+	myIndex->fRecords = NewHandle(0);
+	myIndex->fOrder = NewHandle(0);
+	myIndex->fBuckets = NewHandle(0);
+	
+	if ((myIndex->fPool == NULL) || (myIndex->fRecords == NULL) || (myIndex->fOrder == NULL) || (myIndex->fBuckets == NULL)) {
+		QTShortCut_DisposeShortcutIndex(myIndex);
+		return(memFullErr);
+	}
+	
+	*theIndex = myIndex;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_IndexShortcutFolder
+// Add the shortcut movie files in the specified folder (and in the folders inside it) to the specified index.
+//
+// The files are read while the folders are still being scanned, with up to theMaxInFlight reads outstanding at once
+// (on Windows, the files are read one at a time). A file that's already in the index with the same modification
+// date isn't read again, so indexing a folder a second time reads just the files that are new or have changed;
+// but shortcuts that have been deleted aren't noticed, so remove them with QTShortCut_UpdateShortcutIndex. Movie
+// files larger than kShortcutMaxScanSize are taken not to be shortcuts.
+//
+// If theStats is not NULL, it receives counts of what was done and the time it took. Files that can't be read are
+// counted but don't stop the scan; the function result is an error only if the scan itself couldn't be completed.
+//
+//////////
+
+OSErr QTShortCut_IndexShortcutFolder (QTShortCutIndexPtr theIndex, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutIndexStatsPtr theStats)
+{
+	QTShortCutIndexScan			myScan;
+	QTShortCutIndexStats		myStats;
+	unsigned long				myStartTicks = TickCount();
+	OSErr						myReadErr = noErr;
+	OSErr						myErr = noErr;
+	
+	if (theIndex == NULL)
+		return(paramErr);
+	
+	BlockZero(&myStats, sizeof(myStats));
+	
+	myScan.fIndex = theIndex;
+	myScan.fStats = &myStats;
+	
+	myErr = QTShortCut_NewTreeReader(&myScan.fReader, theMaxInFlight, QTShortCut_IndexFileData, &myScan);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myErr = QTShortCut_ScanFolder(theVRefNum, theDirID, QTShortCut_IndexScanFile, &myScan);
+	
+	// wait for the reads still outstanding, even if the scan stopped early
+	myReadErr = QTShortCut_FinishTreeReads(&myScan.fReader);
+	if (myErr == noErr)
+		myErr = myReadErr;
+	
+	QTShortCut_DisposeTreeReader(&myScan.fReader);
+	
+	myStats.fNumEntries = theIndex->fNumRecords - theIndex->fNumRemoved;
+	myStats.fTicks = TickCount() - myStartTicks;
+	if (theStats != NULL)
+		*theStats = myStats;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_UpdateShortcutIndex
+// Bring the entry for the specified file in the specified index up to date, after the file has been created,
+// changed, or deleted: the file is read again, and if it's no longer a shortcut (or is gone), it's removed.
+//
+//////////
+
+OSErr QTShortCut_UpdateShortcutIndex (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr)
+{
+	OSType				myDataRefType;
+	Ptr					myDataRefPtr;
+	long				myDataRefSize;
+	Ptr					myBuffer;
+	long				myFileID;
+	unsigned long		myModDate;
+	long				mySize;
+	OSErr				myErr = noErr;
+	
+	if ((theIndex == NULL) || (theFSSpecPtr == NULL))
+		return(paramErr);
+	
+	// whatever the file holds now, the old entry is out of date
+	QTShortCut_RemoveIndexRecord(theIndex, theFSSpecPtr);
+	
+	myErr = QTShortCut_GetFileStamp(theFSSpecPtr, &myFileID, &myModDate, &mySize);
+	if ((myErr == fnfErr) || (myErr == dirNFErr) || (myErr == notAFileErr))
+		return(noErr);
+	if (myErr != noErr)
+		return(myErr);
+	
+	if ((mySize < (long)kShortcutHeaderSize) || (mySize > kShortcutMaxScanSize))
+		return(noErr);
+	
+	myBuffer = QTShortCut_GetScratch(mySize);
+	if (myBuffer == NULL)
+		return(memFullErr);
+	
+	myErr = QTShortCut_ReadShortcutMovieFile(theFSSpecPtr, myBuffer, mySize, &myDataRefType, &myDataRefPtr, &myDataRefSize);
+	if (myErr == invalidAtomErr)
+		return(noErr);
+	if (myErr != noErr)
+		return(myErr);
+	
+	return(QTShortCut_AddIndexRecord(theIndex, theFSSpecPtr, myModDate, myDataRefType, myDataRefPtr, myDataRefSize));
+}
+
+
+//////////
+//
+// QTShortCut_FindInShortcutIndex
+// Find the shortcuts in the specified index whose data references begin with the specified prefix and are of the
+// specified type (or of any type, if theDataRefType is 0). The first theMaxCount of them are returned in theFSSpecs
+// (which may be NULL if theMaxCount is 0), in order of their data references, and theCount receives the number of
+// shortcuts found, which may be more than theMaxCount.
+//
+// To find the shortcuts to a single target, pass its whole data reference as the prefix (for a URL, that includes
+// the terminating zero byte, so that longer URLs don't match too); to find those to all the files on a server, or
+// in a folder, pass the beginning of the URL. The search takes time in proportion to the log of the size of the
+// index, plus the number of shortcuts found; the first search after the index has changed sorts the new records.
+//
+//////////
+
+OSErr QTShortCut_FindInShortcutIndex (QTShortCutIndexPtr theIndex, OSType theDataRefType, Ptr thePrefix, long thePrefixSize, FSSpec theFSSpecs[], long theMaxCount, long *theCount)
+{
+	QTShortCutIndexRecordPtr	myRecords;
+	QTShortCutIndexRecordPtr	myRecord;
+	long						*myOrder;
+	Ptr							myPool;
+	long						myLow;
+	long						myHigh;
+	long						myMiddle;
+	long						myCount = 0L;
+	OSErr						myErr = noErr;
+	
+	if ((theIndex == NULL) || (theCount == NULL) || (thePrefixSize < 0) || ((thePrefix == NULL) && (thePrefixSize > 0)))
+		return(paramErr);
+	
+	if ((theFSSpecs == NULL) && (theMaxCount > 0))
+		return(paramErr);
+	
+	*theCount = 0L;
+	
+	myErr = QTShortCut_SortShortcutIndex(theIndex);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myPool = *theIndex->fPool;
+	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	myOrder = (long *)*theIndex->fOrder;
+	
+	// find the first data reference that isn't less than the prefix
+	myLow = 0L;
+	myHigh = theIndex->fNumRecords;
+	while (myLow < myHigh) {
+		myMiddle = myLow + ((myHigh - myLow) / 2);
+		myRecord = &myRecords[myOrder[myMiddle]];
+		if (QTShortCut_CompareKeyToPrefix(myPool + myRecord->fKeyOffset, myRecord->fKeySize, thePrefix, thePrefixSize) < 0)
+			myLow = myMiddle + 1;
+		else
+			myHigh = myMiddle;
+	}
+	
+	// the data references that begin with the prefix all follow it
+	for (; myLow < theIndex->fNumRecords; myLow++) {
+		myRecord = &myRecords[myOrder[myLow]];
+		if (!QTShortCut_HasPrefix(myPool + myRecord->fKeyOffset, myRecord->fKeySize, thePrefix, thePrefixSize))
+			break;
+		
+		if (myRecord->fRemoved || ((theDataRefType != 0) && (myRecord->fDataRefType != theDataRefType)))
+			continue;
+		
+		if (myCount < theMaxCount) {
+			theFSSpecs[myCount].vRefNum = myRecord->fVRefNum;
+			theFSSpecs[myCount].parID = myRecord->fParID;
+			BlockMoveData(myPool + myRecord->fNameOffset, theFSSpecs[myCount].name, ((StringPtr)(myPool + myRecord->fNameOffset))[0] + 1);
+		}
+		
+		myCount++;
+	}
+	
+	*theCount = myCount;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_DisposeShortcutIndex
+// Dispose of the specified index.
+//
+//////////
+
+void QTShortCut_DisposeShortcutIndex (QTShortCutIndexPtr theIndex)
+{
+	if (theIndex == NULL)
+		return;
+	
+	if (theIndex->fPool != NULL)
+		DisposeHandle(theIndex->fPool);
+	if (theIndex->fRecords != NULL)
+		DisposeHandle(theIndex->fRecords);
+	if (theIndex->fOrder != NULL)
+		DisposeHandle(theIndex->fOrder);
+	if (theIndex->fBuckets != NULL)
+		DisposeHandle(theIndex->fBuckets);
+	
+	DisposePtr((Ptr)theIndex);
+}
+
+
+//////////
+//
+// QTShortCut_ValidateShortcutFolder
+// Check that the shortcut movie files in the specified folder (and in the folders inside it) are laid out just as
+// QTShortCut_CreateShortcutMovieFile writes them: a movie atom that fills the file, containing a movie data reference
+// alias atom that fills the movie atom, containing a data reference atom that fills that, holding an alias or a URL.
+// The atom sizes (which may be extended) are checked against the length of the file, and a data reference that's
+// small enough to have been read whole is checked too: an alias must be no shorter than the size it gives itself,
+// and a URL must be a non-empty C string. If theCheckTargets is true, the target of each alias is looked up (on the
+// Mac only; the targets of URLs are never looked up). A movie file whose first atom isn't a movie atom beginning
+// with a movie data reference alias atom is an ordinary movie, not a shortcut; it's counted, but not reported.
+//
+// The files are read while the folders are still being scanned, with up to theMaxInFlight reads outstanding at once,
+// as in QTShortCut_IndexShortcutFolder; aliases are resolved one at a time, but the reads carry on meanwhile. Each
+// file with a problem is passed to theProc, if it's not NULL; returning an error from theProc stops the scan, and
+// is the function result. If theStats is not NULL, it receives counts of what was found and the time it took.
+//
+//////////
+
+OSErr QTShortCut_ValidateShortcutFolder (short theVRefNum, long theDirID, short theMaxInFlight, Boolean theCheckTargets, QTShortCutValidateProcPtr theProc, void *theRefCon, QTShortCutValidateStatsPtr theStats)
+{
+	QTShortCutValidateScan		myScan;
+	QTShortCutValidateStats		myStats;
+	unsigned long				myStartTicks = TickCount();
+	OSErr						myReadErr = noErr;
+	OSErr						myErr = noErr;
+	
+	BlockZero(&myStats, sizeof(myStats));
+	
+	myScan.fProc = theProc;
+	myScan.fRefCon = theRefCon;
+	myScan.fAlias = NULL;
+	myScan.fStats = &myStats;
+	
+#if TARGET_OS_MAC	
+	if (theCheckTargets) {
+		myScan.fAlias = NewHandle(0);
+		if (myScan.fAlias == NULL)
+			return(memFullErr);
+	}
+#endif	// TARGET_OS_MAC	
+	
+	myErr = QTShortCut_NewTreeReader(&myScan.fReader, theMaxInFlight, QTShortCut_ValidateFileData, &myScan);
+	if (myErr == noErr) {
+		myErr = QTShortCut_ScanFolder(theVRefNum, theDirID, QTShortCut_ValidateScanFile, &myScan);
+		
+		// wait for the reads still outstanding, even if the scan stopped early
+		myReadErr = QTShortCut_FinishTreeReads(&myScan.fReader);
+		if (myErr == noErr)
+			myErr = myReadErr;
+		
+		QTShortCut_DisposeTreeReader(&myScan.fReader);
+	}
+	
+	if (myScan.fAlias != NULL)
+		DisposeHandle(myScan.fAlias);
+	
+	myStats.fTicks = TickCount() - myStartTicks;
+	if (theStats != NULL)
+		*theStats = myStats;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_GetScratch
+// Get a block of scratch memory at least theSize bytes long, which is valid until the next call to this function
+// or to QTShortCut_ReleaseScratchMemory; return NULL if there isn't enough memory.
+//
+// The block is allocated only if the one we already have is too small, and it is never shrunk; it's rounded up
+// to a multiple of 4K, so that slowly growing requests don't each cause a new allocation. Since the caller is done
+// with the block by the time the next file is started, the block is in effect reset between files.
+//
+//////////
+
+static Ptr QTShortCut_GetScratch (long theSize)
+{
+	if (theSize <= gScratchSize)
+		return(gScratch);
+	
+	if (gScratch != NULL)
+		DisposePtr(gScratch);
+	
+	gScratchSize = (theSize + 0x0FFF) & ~0x0FFF;
+	gScratch = NewPtr(gScratchSize);
+	if (gScratch == NULL)
+		gScratchSize = 0L;
+	
+	return(gScratch);
+}
+
+
+//////////
+//
+// QTShortCut_GrowArray
+// Make sure that the specified handle, which holds an array of items of the specified size, has room for theCount
+// items; the handle is grown by doubling, so that adding items one at a time doesn't resize it each time.
+//
+//////////
+
+static OSErr QTShortCut_GrowArray (Handle theArray, long theCount, long theItemSize)
+{
+	long			mySize = GetHandleSize(theArray);
+	
+	if (theCount * theItemSize <= mySize)
+		return(noErr);
+	
+	if (mySize < 16 * theItemSize)
+		mySize = 16 * theItemSize;
+	while (mySize < theCount * theItemSize)
+		mySize *= 2;
+	
+	SetHandleSize(theArray, mySize);
+	
+	return(MemError());
+}
+
+
+//////////
+//
+// QTShortCut_GetFileStamp
+// Get the file ID, modification date, and data fork size of the specified file from the catalog, without opening it.
+//
+//////////
+
+static OSErr QTShortCut_GetFileStamp (FSSpecPtr theFSSpecPtr, long *theFileID, unsigned long *theModDate, long *theSize)
+{
+	CInfoPBRec		myPB;
+	Str63			myName;
+	OSErr			myErr = noErr;
+	
+	// PBGetCatInfo may change the name, so give it a copy
+	BlockMoveData(theFSSpecPtr->name, myName, theFSSpecPtr->name[0] + 1);
+	
+	myPB.hFileInfo.ioCompletion = NULL;
+	myPB.hFileInfo.ioNamePtr = myName;
+	myPB.hFileInfo.ioVRefNum = theFSSpecPtr->vRefNum;
+	myPB.hFileInfo.ioDirID = theFSSpecPtr->parID;
+	myPB.hFileInfo.ioFDirIndex = 0;
+	
+	myErr = PBGetCatInfoSync(&myPB);
+	if (myErr != noErr)
+		return(myErr);
+	
+	// make sure it's a file, not a folder
+	if ((myPB.hFileInfo.ioFlAttrib & ioDirMask) != 0)
+		return(notAFileErr);
+	
+	*theFileID = myPB.hFileInfo.ioDirID;
+	*theModDate = myPB.hFileInfo.ioFlMdDat;
+	*theSize = myPB.hFileInfo.ioFlLgLen;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_IsSameFile
+// Determine whether the two specified file system specifications refer to the same file.
+//
+//////////
+
+static Boolean QTShortCut_IsSameFile (FSSpecPtr theFSSpecPtr1, FSSpecPtr theFSSpecPtr2)
+{
+	return((theFSSpecPtr1->vRefNum == theFSSpecPtr2->vRefNum) &&
+		   (theFSSpecPtr1->parID == theFSSpecPtr2->parID) &&
+		   EqualString(theFSSpecPtr1->name, theFSSpecPtr2->name, false, true));
+}
+
+
+//////////
+//
+// QTShortCut_GetBigEndianLong
+// Get the big-endian long integer at the specified address, which need not be aligned.
+//
+//////////
+
+static unsigned long QTShortCut_GetBigEndianLong (Ptr thePtr)
+{
+	unsigned char	*myBytes = (unsigned char *)thePtr;
+	
+	return(((unsigned long)myBytes[0] << 24) | ((unsigned long)myBytes[1] << 16) | ((unsigned long)myBytes[2] << 8) | (unsigned long)myBytes[3]);
+}
+
+
+//////////
+//
+// QTShortCut_ScanFolder
+// Call the specified function for each movie file in the specified folder and all the folders inside it.
+//
+//////////
+
+static OSErr QTShortCut_ScanFolder (short theVRefNum, long theDirID, QTShortCutScanProcPtr theProc, void *theRefCon)
+{
+	CInfoPBRec		myPB;
+	FSSpec			myFSSpec;
+	short			myIndex;
+	OSErr			myErr = noErr;
+	
+	for (myIndex = 1; ; myIndex++) {
+		myPB.hFileInfo.ioCompletion = NULL;
+		myPB.hFileInfo.ioNamePtr = myFSSpec.name;
+		myPB.hFileInfo.ioVRefNum = theVRefNum;
+		myPB.hFileInfo.ioDirID = theDirID;
+		myPB.hFileInfo.ioFDirIndex = myIndex;
+		
+		// we've run out of items in the folder when we get fnfErr
+		myErr = PBGetCatInfoSync(&myPB);
+		if (myErr == fnfErr)
+			return(noErr);
+		if (myErr != noErr)
+			return(myErr);
+		
+		if ((myPB.hFileInfo.ioFlAttrib & ioDirMask) != 0) {
+			myErr = QTShortCut_ScanFolder(theVRefNum, myPB.dirInfo.ioDrDirID, theProc, theRefCon);
+		} else if (myPB.hFileInfo.ioFlFndrInfo.fdType == kShortcutFileType) {
+			myFSSpec.vRefNum = theVRefNum;
+			myFSSpec.parID = theDirID;
+			myErr = (*theProc)(&myFSSpec, myPB.hFileInfo.ioFlLgLen, myPB.hFileInfo.ioFlMdDat, theRefCon);
+		}
+		
+		if (myErr != noErr)
+			return(myErr);
+	}
+}
+
+
+//////////
+//
+// QTShortCut_RetargetFile
+// Apply the retargeting rules to the specified shortcut movie file, as part of a call to QTShortCut_RetargetShortcuts.
+//
+//////////
+
+static OSErr QTShortCut_RetargetFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon)
+{
+	QTShortCutRetargetStatePtr	myState = (QTShortCutRetargetStatePtr)theRefCon;
+	QTShortCutRetargetStatsPtr	myStats = myState->fStats;
+	QTShortCutRetargetRulePtr	myRule = NULL;
+	OSType						myDataRefType;
+	Ptr							myDataRefPtr;
+	long						myDataRefSize;
+	long						myNewSize;
+	long						myBufferSize;
+	Boolean						myInPlace;
+	long						myFlags;
+	short						myIndex;
+	OSErr						myErr = noErr;
+	
+	myStats->fNumScanned++;
+	
+	// a movie file this large is an ordinary movie, not a shortcut, so there's no point in reading it
+	if (theSize > kShortcutMaxScanSize) {
+		myStats->fNumSkipped++;
+		return(noErr);
+	}
+	
+	// read the whole file into the reusable file data handle
+	SetHandleSize(myState->fFileData, theSize);
+	if (MemError() != noErr) {
+		myStats->fNumErrors++;
+		return(noErr);
+	}
+	
+	HLock(myState->fFileData);
+	
+	myErr = QTShortCut_ReadShortcutMovieFile(theFSSpecPtr, *myState->fFileData, theSize, &myDataRefType, &myDataRefPtr, &myDataRefSize);
+	if (myErr != noErr) {
+		if (myErr == invalidAtomErr)
+			myStats->fNumSkipped++;
+		else
+			myStats->fNumErrors++;
+		goto bail;
+	}
+	
+	for (myIndex = 0; (myIndex < myState->fNumRules) && (myRule == NULL); myIndex++) {
+		QTShortCutRetargetRulePtr	myCandidate = &myState->fRules[myIndex];
+		
+		if (((myCandidate->fDataRefType == 0) || (myCandidate->fDataRefType == myDataRefType)) &&
+			QTShortCut_HasPrefix(myDataRefPtr, myDataRefSize, myCandidate->fOldPrefix, myCandidate->fOldPrefixSize))
+			myRule = myCandidate;
+	}
+	
+	if (myRule == NULL)
+		goto bail;
+	
+	// build the new data reference in the reusable data reference handle
+	myNewSize = myDataRefSize - myRule->fOldPrefixSize + myRule->fNewPrefixSize;
+	myInPlace = (myNewSize == myDataRefSize) || ((myDataRefType == URLDataHandlerSubType) && (myNewSize < myDataRefSize));
+	myBufferSize = myInPlace ? myDataRefSize : myNewSize;
+	
+	SetHandleSize(myState->fDataRef, myBufferSize);
+	myErr = MemError();
+	if (myErr != noErr) {
+		myStats->fNumErrors++;
+		goto bail;
+	}
+	
+	BlockMoveData(myRule->fNewPrefix, *myState->fDataRef, myRule->fNewPrefixSize);
+	BlockMoveData(myDataRefPtr + myRule->fOldPrefixSize, *myState->fDataRef + myRule->fNewPrefixSize, myDataRefSize - myRule->fOldPrefixSize);
+	if (myBufferSize > myNewSize)
+		BlockZero(*myState->fDataRef + myNewSize, myBufferSize - myNewSize);
+	
+	if (myInPlace) {
+		HLock(myState->fDataRef);
+		myErr = QTShortCut_PatchDataRef(theFSSpecPtr, myDataRefPtr - *myState->fFileData, *myState->fDataRef, myBufferSize);
+		HUnlock(myState->fDataRef);
+		if (myErr == noErr)
+			myStats->fNumInPlace++;
+	} else {
+		// the atom sizes change, so the whole file is rewritten, and then replaces the old one atomically
+		myFlags = gWriteFlags;
+		gWriteFlags |= kShortcutWriteAtomicReplace;
+		myErr = QTShortCut_WriteShortcutData(myState->fDataRef, myDataRefType, theFSSpecPtr, kShortcutFlushNone);
+		gWriteFlags = myFlags;
+		if (myErr == noErr)
+			myStats->fNumReplaced++;
+	}
+	
+	if (myErr == noErr)
+		myStats->fNumChanged++;
+	else
+		myStats->fNumErrors++;
+
+bail:
+	HUnlock(myState->fFileData);
+	
+	// a problem with one file, even running out of memory for it, doesn't stop the scan
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_PatchDataRef
+// Write the specified data reference over the data reference in the specified shortcut movie file,
+// which must be the same size and begin at theOffset in the file.
+//
+//////////
+
+static OSErr QTShortCut_PatchDataRef (FSSpecPtr theFSSpecPtr, long theOffset, Ptr theDataRef, long theDataRefSize)
+{
+	short			myRefNum = 0;
+	long			mySize = theDataRefSize;
+	OSErr			myErr = noErr;
+	
+	myErr = FSpOpenDF(theFSSpecPtr, fsRdWrPerm, &myRefNum);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myErr = SetFPos(myRefNum, fsFromStart, theOffset);
+	if (myErr == noErr)
+		myErr = FSWrite(myRefNum, &mySize, theDataRef);
+	
+	if (myErr == noErr)
+		myErr = FSClose(myRefNum);
+	else
+		FSClose(myRefNum);
+	
+	QTShortCut_InvalidateShortcutCache(theFSSpecPtr);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_HasPrefix
+// Determine whether the specified data begins with the specified prefix.
+//
+//////////
+
+static Boolean QTShortCut_HasPrefix (Ptr theData, long theSize, Ptr thePrefix, long thePrefixSize)
+{
+	long			myIndex;
+	
+	if (thePrefixSize > theSize)
+		return(false);
+	
+	for (myIndex = 0; myIndex < thePrefixSize; myIndex++)
+		if (theData[myIndex] != thePrefix[myIndex])
+			return(false);
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_HashDataRef
+// Return a hash (32-bit FNV-1a) of the specified data reference and its type.
+//
+//////////
+
+static unsigned long QTShortCut_HashDataRef (Handle theDataRef, OSType theDataRefType)
+{
+	unsigned long		myHash = 2166136261UL;
+	unsigned char		*myData = (unsigned char *)*theDataRef;
+	long				mySize = GetHandleSize(theDataRef);
+	long				myIndex;
+	
+	for (myIndex = 0; myIndex < 4; myIndex++)
+		myHash = (myHash ^ ((theDataRefType >> (8 * myIndex)) & 0xFF)) * 16777619UL;
+	
+	for (myIndex = 0; myIndex < mySize; myIndex++)
+		myHash = (myHash ^ myData[myIndex]) * 16777619UL;
+	
+	return(myHash);
+}
+
+
+//////////
+//
+// QTShortCut_ParseManifestRecord
+// Parse the manifest record at the beginning of the specified data, and return its size; return 0 if the data
+// doesn't hold the whole record yet (unless theAtEnd is true, in which case it's the last data there is).
+//
+//////////
+
+static long QTShortCut_ParseManifestRecord (Ptr theData, long theSize, short theFormat, Boolean theAtEnd, QTShortCutManifestRecordPtr theRecord)
+{
+	long			myLineSize;
+	long			myIndex;
+	
+	BlockZero(theRecord, sizeof(QTShortCutManifestRecord));
+	theRecord->fKind = kManifestRecordMalformed;
+	
+	if (theFormat == kShortcutManifestBinary) {
+		// a length byte and the name, the data reference type and size, and the data reference
+		theRecord->fNameSize = (unsigned char)theData[0];
+		if (theSize < 1 + theRecord->fNameSize + (2 * kShortcutFieldSize))
+			return(theAtEnd ? theSize : 0L);
+		
+		theRecord->fName = theData + 1;
+		theRecord->fDataRefType = QTShortCut_GetBigEndianLong(theRecord->fName + theRecord->fNameSize);
+		theRecord->fDataRefSize = (SInt32)QTShortCut_GetBigEndianLong(theRecord->fName + theRecord->fNameSize + kShortcutFieldSize);
+		theRecord->fDataRef = theRecord->fName + theRecord->fNameSize + (2 * kShortcutFieldSize);
+		theRecord->fRecordSize = (theRecord->fDataRef - theData) + theRecord->fDataRefSize;
+		
+		if ((theRecord->fDataRefSize < 0) || (theRecord->fRecordSize < 0))
+			return(theSize);
+		
+		if (theSize < theRecord->fRecordSize)
+			return(theAtEnd ? theSize : 0L);
+		
+		if (theRecord->fNameSize > 0)
+			theRecord->fKind = kManifestRecordOK;
+		
+		return(theRecord->fRecordSize);
+	}
+	
+	// find the end of the line
+	for (myLineSize = 0; myLineSize < theSize; myLineSize++)
+		if (theData[myLineSize] == '\n')
+			break;
+	
+	if ((myLineSize == theSize) && !theAtEnd)
+		return(0L);
+	
+	theRecord->fRecordSize = (myLineSize < theSize) ? myLineSize + 1 : myLineSize;
+	
+	if ((myLineSize > 0) && (theData[myLineSize - 1] == '\r'))
+		myLineSize--;
+	
+	if (myLineSize == 0) {
+		theRecord->fKind = kManifestRecordEmpty;
+		return(theRecord->fRecordSize);
+	}
+	
+	// the name, a tab, four characters of type, and another tab; the rest of the line is the data reference
+	for (myIndex = 0; myIndex < myLineSize; myIndex++)
+		if (theData[myIndex] == '\t')
+			break;
+	
+	if ((myIndex == 0) || (myIndex > 255) || (myIndex + 1 + kShortcutFieldSize >= myLineSize) || (theData[myIndex + 1 + kShortcutFieldSize] != '\t'))
+		return(theRecord->fRecordSize);
+	
+	theRecord->fKind = kManifestRecordOK;
+	theRecord->fName = theData;
+	theRecord->fNameSize = myIndex;
+	theRecord->fDataRefType = QTShortCut_GetBigEndianLong(theData + myIndex + 1);
+	theRecord->fDataRef = theData + myIndex + 2 + kShortcutFieldSize;
+	theRecord->fDataRefSize = myLineSize - (myIndex + 2 + kShortcutFieldSize);
+	
+	return(theRecord->fRecordSize);
+}
+
+
+//////////
+//
+// QTShortCut_AddToManifestBatch
+// Add the file described by the specified manifest record to the specified batch.
+//
+//////////
+
+static OSErr QTShortCut_AddToManifestBatch (QTShortCutManifestBatchPtr theBatch, QTShortCutManifestRecordPtr theRecord, short theFormat, short theVRefNum, long theDirID)
+{
+	Str255			myName;
+	long			mySize = theRecord->fDataRefSize;
+	Handle			myDataRef;
+	OSErr			myErr = noErr;
+	
+	myName[0] = (unsigned char)theRecord->fNameSize;
+	BlockMoveData(theRecord->fName, &myName[1], theRecord->fNameSize);
+	
+	myErr = FSMakeFSSpec(theVRefNum, theDirID, myName, &theBatch->fFSSpecs[theBatch->fCount]);
+	if (myErr == fnfErr)
+		myErr = noErr;
+	if (myErr != noErr)
+		return(myErr);
+	
+	// a URL on a line of text doesn't include the zero byte that ends a URL data reference
+	if ((theFormat == kShortcutManifestLines) && (theRecord->fDataRefType == URLDataHandlerSubType))
+		mySize++;
+	
+	myDataRef = theBatch->fDataRefs[theBatch->fCount];
+	if (myDataRef == NULL) {
+		myDataRef = NewHandle(mySize);
+		theBatch->fDataRefs[theBatch->fCount] = myDataRef;
+	} else {
+		SetHandleSize(myDataRef, mySize);
+	}
+	
+	myErr = MemError();
+	if ((myErr == noErr) && (myDataRef == NULL))
+		myErr = memFullErr;
+	if (myErr != noErr)
+		return(myErr);
+	
+	BlockMoveData(theRecord->fDataRef, *myDataRef, theRecord->fDataRefSize);
+	if (mySize > theRecord->fDataRefSize)
+		(*myDataRef)[theRecord->fDataRefSize] = 0;
+	
+	theBatch->fDataRefTypes[theBatch->fCount] = theRecord->fDataRefType;
+	theBatch->fCount++;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_WriteManifestBatch
+// Write the files in the specified batch, count how many were written, and empty the batch.
+//
+//////////
+
+static void QTShortCut_WriteManifestBatch (QTShortCutManifestBatchPtr theBatch, short theMaxInFlight, QTShortCutManifestStatsPtr theStats)
+{
+	long			myIndex;
+	
+	if (theMaxInFlight > 1)
+		QTShortCut_CreateShortcutMovieFilesAsync(theBatch->fDataRefs, theBatch->fDataRefTypes, theBatch->fFSSpecs, theBatch->fCount, theMaxInFlight, theBatch->fErrors);
+	else
+		QTShortCut_CreateShortcutMovieFiles(theBatch->fDataRefs, theBatch->fDataRefTypes, theBatch->fFSSpecs, theBatch->fCount, theBatch->fErrors);
+	
+	for (myIndex = 0; myIndex < theBatch->fCount; myIndex++) {
+		if (theBatch->fErrors[myIndex] == noErr)
+			theStats->fNumCreated++;
+		else
+			theStats->fNumErrors++;
+	}
+	
+	theBatch->fCount = 0L;
+}
+
+
+//////////
+//
+// QTShortCut_ReadManifestFile
+// Read the next part of a manifest from an open file; theRefCon points to the file's reference number.
+//
+//////////
+
+static OSErr QTShortCut_ReadManifestFile (Ptr theBuffer, long *theSize, void *theRefCon)
+{
+	return(FSRead(*(short *)theRefCon, theSize, theBuffer));
+}
+
+
+//////////
+//
+// QTShortCut_FindDuplicates
+// For each of the specified data references, set theFirsts[i] to the index of the first data reference in
+// the list that has the same type and the same contents (this is i itself, if there's no earlier one).
+//
+// theSlots is the hash table used to find them; theNumSlots must be a power of two, greater than theCount.
+// Data references whose hashes match are compared byte for byte, so a collision never causes a false match.
+//
+//////////
+
+static void QTShortCut_FindDuplicates (Handle theDataRefs[], OSType theDataRefTypes[], long theCount, long theFirsts[], long theSlots[], long theNumSlots)
+{
+	long			myIndex;
+	long			mySlot;
+	
+	for (mySlot = 0; mySlot < theNumSlots; mySlot++)
+		theSlots[mySlot] = -1L;
+	
+	for (myIndex = 0; myIndex < theCount; myIndex++) {
+		Handle		myDataRef = theDataRefs[myIndex];
+		long		mySize;
+		
+		theFirsts[myIndex] = myIndex;
+		if (myDataRef == NULL)
+			continue;
+		
+		mySize = GetHandleSize(myDataRef);
+		mySlot = QTShortCut_HashDataRef(myDataRef, theDataRefTypes[myIndex]) & (theNumSlots - 1);
+		
+		// probe linearly until we find a matching data reference or an empty slot
+		while (theSlots[mySlot] != -1L) {
+			long	myOther = theSlots[mySlot];
+			
+			if ((theDataRefTypes[myOther] == theDataRefTypes[myIndex]) && (GetHandleSize(theDataRefs[myOther]) == mySize) &&
+				QTShortCut_HasPrefix(*myDataRef, mySize, *theDataRefs[myOther], mySize)) {
+				theFirsts[myIndex] = myOther;
+				break;
+			}
+			
+			mySlot = (mySlot + 1) & (theNumSlots - 1);
+		}
+		
+		if (theSlots[mySlot] == -1L)
+			theSlots[mySlot] = myIndex;
+	}
+}
+
+
+//////////
+//
+// QTShortCut_GetPackIndex
+// Check the header of the specified shortcut pack file data, and get the number of shortcuts and the address of the index.
+//
+//////////
+
+static OSErr QTShortCut_GetPackIndex (Ptr thePack, long thePackSize, long *theCount, Ptr *theIndex)
+{
+	unsigned long		myCount;
+	unsigned long		myOffset;
+	
+	if ((thePackSize < (long)kShortcutPackHeaderSize) ||
+		(QTShortCut_GetBigEndianLong(thePack) != kShortcutPackMagic) ||
+		(QTShortCut_GetBigEndianLong(thePack + (1 * kShortcutFieldSize)) != kShortcutPackVersion))
+		return(invalidAtomErr);
+	
+	myCount = QTShortCut_GetBigEndianLong(thePack + (2 * kShortcutFieldSize));
+	myOffset = QTShortCut_GetBigEndianLong(thePack + (3 * kShortcutFieldSize));
+	
+	// the index must lie entirely within the pack
+	if ((myOffset < kShortcutPackHeaderSize) || (myOffset > (unsigned long)thePackSize) ||
+		(myCount > ((unsigned long)thePackSize - myOffset) / kShortcutPackIndexEntrySize))
+		return(invalidAtomErr);
+	
+	*theCount = (long)myCount;
+	*theIndex = thePack + myOffset;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_GetPackEntry
+// Get the name and the movie atom of the specified entry in the index of the specified shortcut pack file data;
+// return false if they don't lie entirely within the pack.
+//
+//////////
+
+static Boolean QTShortCut_GetPackEntry (Ptr thePack, long thePackSize, Ptr theIndex, long theEntry, StringPtr *theName, Ptr *theShortcutPtr, long *theShortcutSize)
+{
+	Ptr					myEntry = theIndex + (theEntry * kShortcutPackIndexEntrySize);
+	unsigned long		myNameOffset = QTShortCut_GetBigEndianLong(myEntry);
+	unsigned long		myOffset = QTShortCut_GetBigEndianLong(myEntry + (1 * kShortcutFieldSize));
+	unsigned long		mySize = QTShortCut_GetBigEndianLong(myEntry + (2 * kShortcutFieldSize));
+	
+	if ((myNameOffset >= (unsigned long)thePackSize) || ((unsigned char)thePack[myNameOffset] >= (unsigned long)thePackSize - myNameOffset))
+		return(false);
+	
+	// a pack might come from anywhere, and a name that isn't a leaf name could put a file outside the folder it's
+	// extracted into
+	if (!QTShortCut_IsLeafName((StringPtr)(thePack + myNameOffset)))
+		return(false);
+	
+	if ((myOffset > (unsigned long)thePackSize) || (mySize > (unsigned long)thePackSize - myOffset))
+		return(false);
+	
+	*theName = (StringPtr)(thePack + myNameOffset);
+	*theShortcutPtr = thePack + myOffset;
+	*theShortcutSize = (long)mySize;
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_CompareNames
+// Compare the two specified names byte by byte; return a negative number, zero, or a positive number if the first
+// name comes before, is the same as, or comes after the second one. A name comes before any longer name it begins.
+//
+//////////
+
+static short QTShortCut_CompareNames (ConstStr255Param theName1, ConstStr255Param theName2)
+{
+	short			myLength = (theName1[0] < theName2[0]) ? theName1[0] : theName2[0];
+	short			myIndex;
+	
+	for (myIndex = 1; myIndex <= myLength; myIndex++)
+		if (theName1[myIndex] != theName2[myIndex])
+			return((short)theName1[myIndex] - (short)theName2[myIndex]);
+	
+	return((short)theName1[0] - (short)theName2[0]);
+}
+
+
+//////////
+//
+// QTShortCut_IsLeafName
+// Return true if the specified name names a file in a folder, and not the folder itself or a path to some other
+// folder: that is, if it isn't empty and contains no colons (and, on Windows, no slashes or backslashes, and isn't
+// "." or "..").
+//
+//////////
+
+static Boolean QTShortCut_IsLeafName (ConstStr255Param theName)
+{
+	short			myIndex;
+	
+	// an empty name gives the FSSpec of the folder itself
+	if (theName[0] == 0)
+		return(false);
+	
+#if TARGET_OS_MAC	
+	for (myIndex = 1; myIndex <= theName[0]; myIndex++)
+		if (theName[myIndex] == ':')
+			return(false);
+#else
+	if ((theName[1] == '.') && ((theName[0] == 1) || ((theName[0] == 2) && (theName[2] == '.'))))
+		return(false);
+	
+	for (myIndex = 1; myIndex <= theName[0]; myIndex++)
+		if ((theName[myIndex] == ':') || (theName[myIndex] == '/') || (theName[myIndex] == '\\'))
+			return(false);
+#endif	// TARGET_OS_MAC	
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_SortNames
+// Sort the specified list of indices into theNames so that the names they refer to are in order (a heap sort,
+// so that the time taken stays reasonable even for very large packs, without allocating any memory).
+//
+//////////
+
+static void QTShortCut_SortNames (StringPtr theNames[], long theOrder[], long theCount)
+{
+	long			myEnd;
+	long			myStart;
+	long			myRoot;
+	long			myChild;
+	long			mySwap;
+	
+	// build the heap, and then repeatedly move the largest remaining name to the end
+	for (myStart = theCount / 2; myStart >= 0; myStart--) {
+		for (myRoot = myStart; (myChild = (2 * myRoot) + 1) < theCount; myRoot = myChild) {
+			if ((myChild + 1 < theCount) && (QTShortCut_CompareNames(theNames[theOrder[myChild]], theNames[theOrder[myChild + 1]]) < 0))
+				myChild++;
+			if (QTShortCut_CompareNames(theNames[theOrder[myRoot]], theNames[theOrder[myChild]]) >= 0)
+				break;
+			mySwap = theOrder[myRoot]; theOrder[myRoot] = theOrder[myChild]; theOrder[myChild] = mySwap;
+		}
+	}
+	
+	for (myEnd = theCount - 1; myEnd > 0; myEnd--) {
+		mySwap = theOrder[0]; theOrder[0] = theOrder[myEnd]; theOrder[myEnd] = mySwap;
+		
+		for (myRoot = 0; (myChild = (2 * myRoot) + 1) < myEnd; myRoot = myChild) {
+			if ((myChild + 1 < myEnd) && (QTShortCut_CompareNames(theNames[theOrder[myChild]], theNames[theOrder[myChild + 1]]) < 0))
+				myChild++;
+			if (QTShortCut_CompareNames(theNames[theOrder[myRoot]], theNames[theOrder[myChild]]) >= 0)
+				break;
+			mySwap = theOrder[myRoot]; theOrder[myRoot] = theOrder[myChild]; theOrder[myChild] = mySwap;
+		}
+	}
+}
+
+
+//////////
+//
+// QTShortCut_GetBigEndianShort
+// Get the big-endian short integer at the specified address, which need not be aligned.
+//
+//////////
+
+static unsigned short QTShortCut_GetBigEndianShort (Ptr thePtr)
+{
+	unsigned char	*myBytes = (unsigned char *)thePtr;
+	
+	return((unsigned short)(((unsigned short)myBytes[0] << 8) | (unsigned short)myBytes[1]));
+}
+
+
+//////////
+//
+// QTShortCut_GetAtomHeader
+// Get the size and type of the atom at the specified offset in the specified data, and the size of its header;
+// return false if the atom's header is malformed or the atom extends past theEnd.
+//
+// A size of 1 means that the atom has an extended header, with a 64-bit size after the type; a size of 0 means
+// that the atom extends to theEnd.
+//
+//////////
+
+static Boolean QTShortCut_GetAtomHeader (Ptr theData, long theEnd, long theOffset, long *theAtomSize, OSType *theAtomType, long *theHeaderSize)
+{
+	unsigned long	mySize;
+	long			myHeaderSize = kRefMovieAtomHeaderSize;
+	
+	if ((theOffset < 0) || (theEnd - theOffset < kRefMovieAtomHeaderSize))
+		return(false);
+	
+	mySize = QTShortCut_GetBigEndianLong(theData + theOffset);
+	if (mySize == 0) {
+		mySize = theEnd - theOffset;
+	} else if (mySize == 1) {
+		// the data is all in memory, so an atom inside it can't have a size with any of the high 32 bits set
+		myHeaderSize = kExtendedAtomHeaderSize;
+		if ((theEnd - theOffset < kExtendedAtomHeaderSize) || (QTShortCut_GetBigEndianLong(theData + theOffset + (2 * kShortcutFieldSize)) != 0))
+			return(false);
+		mySize = QTShortCut_GetBigEndianLong(theData + theOffset + (3 * kShortcutFieldSize));
+	}
+	
+	if ((mySize < (unsigned long)myHeaderSize) || (mySize > (unsigned long)(theEnd - theOffset)))
+		return(false);
+	
+	*theAtomSize = (long)mySize;
+	*theAtomType = QTShortCut_GetBigEndianLong(theData + theOffset + kShortcutFieldSize);
+	*theHeaderSize = myHeaderSize;
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_FindAtom
+// Find the first atom of the specified type among the atoms between theStart and theEnd in the specified data;
+// return its offset (and its size and header size), or -1 if there is no such atom or the atoms are malformed.
+//
+//////////
+
+static long QTShortCut_FindAtom (Ptr theData, long theStart, long theEnd, OSType theAtomType, long *theAtomSize, long *theHeaderSize)
+{
+	long			myOffset;
+	OSType			myAtomType;
+	
+	for (myOffset = theStart; myOffset < theEnd; myOffset += *theAtomSize) {
+		if (!QTShortCut_GetAtomHeader(theData, theEnd, myOffset, theAtomSize, &myAtomType, theHeaderSize))
+			return(-1);
+		
+		if (myAtomType == theAtomType)
+			return(myOffset);
+	}
+	
+	return(-1);
+}
+
+
+//////////
+//
+// QTShortCut_ParseDescriptor
+// Fill in the specified choice from the contents of a reference movie descriptor atom, which lie between theStart
+// and theEnd in the specified data; the choice's data reference offset is relative to the beginning of the data.
+// Return false if the atom is malformed or has no data reference atom.
+//
+//////////
+
+static Boolean QTShortCut_ParseDescriptor (Ptr theData, long theStart, long theEnd, QTShortCutRefMovieChoicePtr theChoice)
+{
+	Boolean			myHasDataRef = false;
+	long			myOffset;
+	long			myAtomSize;
+	long			myHeaderSize;
+	long			mySize;
+	OSType			myAtomType;
+	Ptr				myPtr;
+	
+	BlockZero(theChoice, sizeof(QTShortCutRefMovieChoice));
+	
+	for (myOffset = theStart; myOffset < theEnd; myOffset += myAtomSize) {
+		if (!QTShortCut_GetAtomHeader(theData, theEnd, myOffset, &myAtomSize, &myAtomType, &myHeaderSize))
+			return(false);
+		
+		// every atom we know about begins with a long word of flags (except the quality atom), which we skip;
+		// mySize is the size the atom would have with an ordinary header, which the atom sizes below assume
+		myPtr = theData + myOffset + myHeaderSize;
+		mySize = myAtomSize - (myHeaderSize - kRefMovieAtomHeaderSize);
+		
+		switch (myAtomType) {
+			case ReferenceMovieDataRefAID:
+				if (mySize < kRefMovieDataRefAtomSize)
+					return(false);
+				theChoice->fDataRefType = QTShortCut_GetBigEndianLong(myPtr + 4);
+				theChoice->fDataRefSize = (SInt32)QTShortCut_GetBigEndianLong(myPtr + 8);
+				theChoice->fDataRefOffset = (myPtr - theData) + (kRefMovieDataRefAtomSize - kRefMovieAtomHeaderSize);
+				if ((theChoice->fDataRefSize < 0) || (theChoice->fDataRefSize > mySize - kRefMovieDataRefAtomSize))
+					return(false);
+				myHasDataRef = true;
+				break;
+			
+			case ReferenceMovieDataRateAID:
+				if (mySize < kRefMovieDataRateAtomSize)
+					return(false);
+				theChoice->fDataRate = (SInt32)QTShortCut_GetBigEndianLong(myPtr + 4);
+				break;
+			
+			case ReferenceMovieCPURatingAID:
+				if (mySize < kRefMovieCPURatingAtomSize)
+					return(false);
+				theChoice->fCPUSpeed = QTShortCut_GetBigEndianShort(myPtr + 4);
+				break;
+			
+			case ReferenceMovieVersionCheckAID:
+				if (mySize < kRefMovieVersionCheckAtomSize)
+					return(false);
+				theChoice->fChecks |= kRefMovieChoiceVersionCheck;
+				theChoice->fGestaltSelector = QTShortCut_GetBigEndianLong(myPtr + 4);
+				theChoice->fGestaltValue1 = (SInt32)QTShortCut_GetBigEndianLong(myPtr + 8);
+				theChoice->fGestaltValue2 = (SInt32)QTShortCut_GetBigEndianLong(myPtr + 12);
+				theChoice->fGestaltCheckType = QTShortCut_GetBigEndianShort(myPtr + 16);
+				break;
+			
+			case ReferenceMovieComponentCheckAID:
+				if (mySize < kRefMovieComponentCheckAtomSize)
+					return(false);
+				theChoice->fChecks |= kRefMovieChoiceComponentCheck;
+				theChoice->fComponentDesc.componentType = QTShortCut_GetBigEndianLong(myPtr + 4);
+				theChoice->fComponentDesc.componentSubType = QTShortCut_GetBigEndianLong(myPtr + 8);
+				theChoice->fComponentDesc.componentManufacturer = QTShortCut_GetBigEndianLong(myPtr + 12);
+				theChoice->fComponentDesc.componentFlags = QTShortCut_GetBigEndianLong(myPtr + 16);
+				theChoice->fComponentDesc.componentFlagsMask = QTShortCut_GetBigEndianLong(myPtr + 20);
+				theChoice->fComponentMinVersion = (SInt32)QTShortCut_GetBigEndianLong(myPtr + 24);
+				break;
+			
+			case ReferenceMovieQualityAID:
+				if (mySize < kRefMovieQualityAtomSize)
+					return(false);
+				theChoice->fQuality = (SInt32)QTShortCut_GetBigEndianLong(myPtr);
+				break;
+			
+			default:
+				break;
+		}
+	}
+	
+	return(myHasDataRef);
+}
+
+
+//////////
+//
+// QTShortCut_IsChoiceBetter
+// Determine whether the first specified choice should be tried before the second one.
+//
+//////////
+
+static Boolean QTShortCut_IsChoiceBetter (QTShortCutRefMovieChoicePtr theChoice1, QTShortCutRefMovieChoicePtr theChoice2)
+{
+	if (theChoice1->fDataRate != theChoice2->fDataRate)
+		return(theChoice1->fDataRate > theChoice2->fDataRate);
+	
+	return(theChoice1->fQuality > theChoice2->fQuality);
+}
+
+
+//////////
+//
+// QTShortCut_ClientMeetsChecks
+// Determine whether the specified client passes the version and component checks of the specified choice.
+//
+// A version check of type kVersionCheckMin passes if the client's Gestalt response is at least the first value;
+// one of type kVersionCheckMask passes if the response, masked by the second value, equals the first value. A component
+// check passes if the client has a component of the same type, subtype and manufacturer (a zero in the check matches
+// anything) whose version is at least the minimum. A check for a selector or component the client didn't describe fails.
+//
+//////////
+
+static Boolean QTShortCut_ClientMeetsChecks (QTShortCutRefMovieChoicePtr theChoice, QTShortCutClientInfoPtr theClient)
+{
+	ComponentDescription *		myDesc;
+	Boolean						myPassed;
+	short						myIndex;
+	
+	if (theChoice->fChecks & kRefMovieChoiceVersionCheck) {
+		myPassed = false;
+		for (myIndex = 0; (myIndex < theClient->fNumGestalts) && (myIndex < kShortcutMaxClientChecks); myIndex++) {
+			long	myResponse = theClient->fGestaltResponses[myIndex];
+			
+			if (theClient->fGestaltSelectors[myIndex] != theChoice->fGestaltSelector)
+				continue;
+			
+			if (theChoice->fGestaltCheckType == kVersionCheckMask)
+				myPassed = ((myResponse & theChoice->fGestaltValue2) == theChoice->fGestaltValue1);
+			else
+				myPassed = ((unsigned long)myResponse >= (unsigned long)theChoice->fGestaltValue1);
+			break;
+		}
+		
+		if (!myPassed)
+			return(false);
+	}
+	
+	if (theChoice->fChecks & kRefMovieChoiceComponentCheck) {
+		myPassed = false;
+		for (myIndex = 0; (myIndex < theClient->fNumComponents) && (myIndex < kShortcutMaxClientChecks) && !myPassed; myIndex++) {
+			myDesc = &theClient->fComponentDescs[myIndex];
+			
+			myPassed = (((theChoice->fComponentDesc.componentType == 0) || (theChoice->fComponentDesc.componentType == myDesc->componentType)) &&
+						((theChoice->fComponentDesc.componentSubType == 0) || (theChoice->fComponentDesc.componentSubType == myDesc->componentSubType)) &&
+						((theChoice->fComponentDesc.componentManufacturer == 0) || (theChoice->fComponentDesc.componentManufacturer == myDesc->componentManufacturer)) &&
+						(theClient->fComponentVersions[myIndex] >= theChoice->fComponentMinVersion));
+		}
+		
+		if (!myPassed)
+			return(false);
+	}
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_StartPhase
+// If instrumentation is on, get the time at which a step is starting, for passing to QTShortCut_EndPhase.
+//
+//////////
+
+static unsigned long QTShortCut_StartPhase (void)
+{
+	UnsignedWide	myTime;
+	
+	if (!gInstrumenting)
+		return(0L);
+	
+	Microseconds(&myTime);
+	
+	return(myTime.lo);
+}
+
+
+//////////
+//
+// QTShortCut_EndPhase
+// If instrumentation is on, record the time taken by the specified step, which started at the specified time.
+//
+//////////
+
+static void QTShortCut_EndPhase (short thePhase, unsigned long theStart)
+{
+	QTShortCutPhaseHistogram *	myHistogram = &gPhaseHistograms[thePhase];
+	UnsignedWide				myTime;
+	unsigned long				myElapsed;
+	short						myBucket;
+	
+	if (!gInstrumenting)
+		return;
+	
+	// only the low word is needed; the subtraction is right even if it has wrapped around
+	Microseconds(&myTime);
+	myElapsed = myTime.lo - theStart;
+	
+	for (myBucket = 0; (myBucket < kShortcutNumTimeBuckets - 1) && ((myElapsed >> myBucket) != 0); myBucket++)
+		;
+	
+	myHistogram->fCount++;
+	myHistogram->fTotal += myElapsed;
+	if (myElapsed > myHistogram->fMax)
+		myHistogram->fMax = myElapsed;
+	myHistogram->fBuckets[myBucket]++;
+}
+
+
+//////////
+//
+// QTShortCut_PutBigEndianLong
+// Put the specified long integer at the specified address (which need not be aligned) in big-endian format,
+// and return the address just past it.
+//
+//////////
+
+static Ptr QTShortCut_PutBigEndianLong (Ptr thePtr, unsigned long theValue)
+{
+	unsigned char	*myBytes = (unsigned char *)thePtr;
+	
+	myBytes[0] = (unsigned char)(theValue >> 24);
+	myBytes[1] = (unsigned char)(theValue >> 16);
+	myBytes[2] = (unsigned char)(theValue >> 8);
+	myBytes[3] = (unsigned char)theValue;
+	
+	return(thePtr + kShortcutFieldSize);
+}
+
+
+//////////
+//
+// QTShortCut_PutBigEndianShort
+// Put the specified short integer at the specified address (which need not be aligned) in big-endian format,
+// and return the address just past it.
+//
+//////////
+
+static Ptr QTShortCut_PutBigEndianShort (Ptr thePtr, unsigned short theValue)
+{
+	unsigned char	*myBytes = (unsigned char *)thePtr;
+	
+	myBytes[0] = (unsigned char)(theValue >> 8);
+	myBytes[1] = (unsigned char)theValue;
+	
+	return(thePtr + sizeof(short));
+}
+
+
+//////////
+//
+// QTShortCut_PutAtomHeader
+// Put the size and type of an atom at the specified address, and return the address of the atom's data.
+//
+//////////
+
+static Ptr QTShortCut_PutAtomHeader (Ptr thePtr, unsigned long theSize, OSType theType)
+{
+	thePtr = QTShortCut_PutBigEndianLong(thePtr, theSize);
+	return(QTShortCut_PutBigEndianLong(thePtr, theType));
+}
+
+
+//////////
+//
+// QTShortCut_GetDescriptorPrefixSize
+// Get the size of everything in the reference movie descriptor atom for the specified target that comes before
+// its data reference: the descriptor atom's header, the qualifier atoms, and the data reference atom's header.
+//
+//////////
+
+static long QTShortCut_GetDescriptorPrefixSize (QTShortCutRefMovieTargetPtr theTarget)
+{
+	long			mySize = kRefMovieAtomHeaderSize + kRefMovieDataRefAtomSize;
+	
+	if (theTarget->fDataRate != 0)
+		mySize += kRefMovieDataRateAtomSize;
+	if (theTarget->fCPUSpeed != 0)
+		mySize += kRefMovieCPURatingAtomSize;
+	if (theTarget->fGestaltSelector != 0)
+		mySize += kRefMovieVersionCheckAtomSize;
+	if (theTarget->fComponentDesc.componentType != 0)
+		mySize += kRefMovieComponentCheckAtomSize;
+	if (theTarget->fQuality != 0)
+		mySize += kRefMovieQualityAtomSize;
+	
+	return(mySize);
+}
+
+
+//////////
+//
+// QTShortCut_PutDescriptorPrefix
+// Put everything in the reference movie descriptor atom for the specified target that comes before its data
+// reference at the specified address, and return the address where the data reference should go.
+//
+//////////
+
+static Ptr QTShortCut_PutDescriptorPrefix (Ptr thePtr, QTShortCutRefMovieTargetPtr theTarget)
+{
+	long			myDataRefSize = GetHandleSize(theTarget->fDataRef);
+	
+	thePtr = QTShortCut_PutAtomHeader(thePtr, QTShortCut_GetDescriptorPrefixSize(theTarget) + myDataRefSize, ReferenceMovieDescriptorAID);
+	
+	if (theTarget->fDataRate != 0) {
+		thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieDataRateAtomSize, ReferenceMovieDataRateAID);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, 0L);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fDataRate);
+	}
+	
+	if (theTarget->fCPUSpeed != 0) {
+		thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieCPURatingAtomSize, ReferenceMovieCPURatingAID);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, 0L);
+		thePtr = QTShortCut_PutBigEndianShort(thePtr, theTarget->fCPUSpeed);
+	}
+	
+	if (theTarget->fGestaltSelector != 0) {
+		thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieVersionCheckAtomSize, ReferenceMovieVersionCheckAID);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, 0L);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fGestaltSelector);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fGestaltValue1);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fGestaltValue2);
+		thePtr = QTShortCut_PutBigEndianShort(thePtr, theTarget->fGestaltCheckType);
+	}
+	
+	if (theTarget->fComponentDesc.componentType != 0) {
+		thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieComponentCheckAtomSize, ReferenceMovieComponentCheckAID);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, 0L);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentDesc.componentType);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentDesc.componentSubType);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentDesc.componentManufacturer);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentDesc.componentFlags);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentDesc.componentFlagsMask);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fComponentMinVersion);
+	}
+	
+	if (theTarget->fQuality != 0) {
+		thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieQualityAtomSize, ReferenceMovieQualityAID);
+		thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fQuality);
+	}
+	
+	// the data reference atom comes last, so that the data reference itself ends the descriptor atom
+	thePtr = QTShortCut_PutAtomHeader(thePtr, kRefMovieDataRefAtomSize + myDataRefSize, ReferenceMovieDataRefAID);
+	thePtr = QTShortCut_PutBigEndianLong(thePtr, 0L);
+	thePtr = QTShortCut_PutBigEndianLong(thePtr, theTarget->fDataRefType);
+	thePtr = QTShortCut_PutBigEndianLong(thePtr, myDataRefSize);
+	
+	return(thePtr);
+}
+
+
+//////////
+//
+// QTShortCut_MakeTempFSSpec
+// Make a file system specification for a temporary file in the same folder as the specified file.
+//
+// The temporary file's name is the name of the specified file (truncated, if necessary) followed by a tilde
+// and a four-digit hexadecimal serial number, so that no two temporary files in use at once share a name.
+//
+// Whatever has the temporary file's name is deleted before the file is written, so a name is used only if nothing
+// in the folder has it yet (a user's file could happen to be named like one of ours); if every serial number is
+// taken, the function result is dupFNErr.
+//
+//////////
+
+static OSErr QTShortCut_MakeTempFSSpec (FSSpecPtr theFSSpecPtr, FSSpecPtr theTempFSSpecPtr)
+{
+	static char		myHexDigits[] = "0123456789ABCDEF";
+	CInfoPBRec		myPB;
+	unsigned short	myCount;
+	long			myTries;
+	short			myBaseLength;
+	short			myLength;
+	short			myIndex;
+	OSErr			myErr = noErr;
+	
+	theTempFSSpecPtr->vRefNum = theFSSpecPtr->vRefNum;
+	theTempFSSpecPtr->parID = theFSSpecPtr->parID;
+	
+	// file names can be at most 31 characters long, and we need 5 of them for the suffix
+	myBaseLength = theFSSpecPtr->name[0];
+	if (myBaseLength > 31 - 5)
+		myBaseLength = 31 - 5;
+	
+	BlockMove(&theFSSpecPtr->name[1], &theTempFSSpecPtr->name[1], myBaseLength);
+	
+	for (myTries = 0; myTries <= 0xffff; myTries++) {
+		myCount = gTempFileCount++;
+		myLength = myBaseLength;
+		theTempFSSpecPtr->name[++myLength] = '~';
+		for (myIndex = 3; myIndex >= 0; myIndex--)
+			theTempFSSpecPtr->name[++myLength] = myHexDigits[(myCount >> (4 * myIndex)) & 0x0f];
+		
+		theTempFSSpecPtr->name[0] = myLength;
+		
+		// look for a file or folder with this name
+		myPB.hFileInfo.ioCompletion = NULL;
+		myPB.hFileInfo.ioNamePtr = theTempFSSpecPtr->name;
+		myPB.hFileInfo.ioVRefNum = theTempFSSpecPtr->vRefNum;
+		myPB.hFileInfo.ioFDirIndex = 0;
+		myPB.hFileInfo.ioDirID = theTempFSSpecPtr->parID;
+		
+		myErr = PBGetCatInfoSync(&myPB);
+		if (myErr == fnfErr)
+			return(noErr);
+		if (myErr != noErr)
+			return(myErr);
+	}
+	
+	return(dupFNErr);
+}
+
+
+//////////
+//
+// QTShortCut_ReplaceWithTempFile
+// Move the specified temporary file into the place of the specified file.
+//
+//////////
+
+static OSErr QTShortCut_ReplaceWithTempFile (FSSpecPtr theTempFSSpecPtr, FSSpecPtr theFSSpecPtr)
+{
+	OSErr			myErr = noErr;
+	
+	// swap the contents of the two files, so that the target file instantly has the new data,
+	// and then get rid of the temporary file (which now holds the old data)
+	myErr = FSpExchangeFiles(theTempFSSpecPtr, theFSSpecPtr);
+	if (myErr == noErr)
+		return(FSpDelete(theTempFSSpecPtr));
+	
+	// if the volume doesn't support FSpExchangeFiles, we have to delete the target file and then rename the
+	// temporary file; if the target file doesn't exist yet (fnfErr), we just rename the temporary file
+	if (myErr != fnfErr)
+		FSpDelete(theFSSpecPtr);
+	
+	myErr = FSpRename(theTempFSSpecPtr, theFSSpecPtr->name);
+	if (myErr != noErr)
+		FSpDelete(theTempFSSpecPtr);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_IndexScanFile
+// Start reading the specified shortcut movie file, as part of a call to QTShortCut_IndexShortcutFolder,
+// unless the index already holds it as it is now.
+//
+//////////
+
+static OSErr QTShortCut_IndexScanFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon)
+{
+	QTShortCutIndexScanPtr		myScan = (QTShortCutIndexScanPtr)theRefCon;
+	long						myRecord;
+	
+	myScan->fStats->fNumScanned++;
+	
+	myRecord = QTShortCut_FindIndexRecord(myScan->fIndex, theFSSpecPtr);
+	if ((myRecord >= 0) && (((QTShortCutIndexRecordPtr)*myScan->fIndex->fRecords)[myRecord].fModDate == theModDate)) {
+		myScan->fStats->fNumUnchanged++;
+		return(noErr);
+	}
+	
+	return(QTShortCut_SubmitTreeRead(&myScan->fReader, theFSSpecPtr, theSize, theModDate));
+}
+
+
+//////////
+//
+// QTShortCut_IndexFileData
+// Add the shortcut movie file that has just been read to the index, as part of a call to QTShortCut_IndexShortcutFolder.
+//
+//////////
+
+static OSErr QTShortCut_IndexFileData (FSSpecPtr theFSSpecPtr, Ptr theData, long theDataSize, long theFileSize, unsigned long theModDate, OSErr theErr, void *theRefCon)
+{
+	QTShortCutIndexScanPtr		myScan = (QTShortCutIndexScanPtr)theRefCon;
+	OSType						myDataRefType;
+	Ptr							myDataRefPtr;
+	long						myDataRefSize;
+	OSErr						myErr = noErr;
+	
+	if (theErr != noErr) {
+		myScan->fStats->fNumErrors++;
+		return(noErr);
+	}
+	
+	myScan->fStats->fNumRead++;
+	
+	// the old entry for the file, if there is one, is out of date
+	QTShortCut_RemoveIndexRecord(myScan->fIndex, theFSSpecPtr);
+	
+	if ((theDataSize < theFileSize) || (QTShortCut_ParseShortcutData(theData, theDataSize, &myDataRefType, &myDataRefPtr, &myDataRefSize) != noErr)) {
+		myScan->fStats->fNumSkipped++;
+		return(noErr);
+	}
+	
+	myErr = QTShortCut_AddIndexRecord(myScan->fIndex, theFSSpecPtr, theModDate, myDataRefType, myDataRefPtr, myDataRefSize);
+	if (myErr == noErr)
+		myScan->fStats->fNumIndexed++;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_HashIndexFile
+// Get the hash value of the specified file, for the hash table of a reverse index. File names are compared without
+// regard to case, so the letters are hashed as capitals, and characters outside the ASCII range are left out.
+//
+//////////
+
+static unsigned long QTShortCut_HashIndexFile (FSSpecPtr theFSSpecPtr)
+{
+	unsigned long		myHash = 2166136261UL;
+	unsigned char		myChar;
+	short				myIndex;
+	
+	myHash = (myHash ^ (unsigned short)theFSSpecPtr->vRefNum) * 16777619UL;
+	for (myIndex = 0; myIndex < 4; myIndex++)
+		myHash = (myHash ^ (((unsigned long)theFSSpecPtr->parID >> (8 * myIndex)) & 0xFF)) * 16777619UL;
+	
+	for (myIndex = 1; myIndex <= theFSSpecPtr->name[0]; myIndex++) {
+		myChar = theFSSpecPtr->name[myIndex];
+		if (myChar >= 0x80)
+			continue;
+		if ((myChar >= 'a') && (myChar <= 'z'))
+			myChar -= 'a' - 'A';
+		myHash = (myHash ^ myChar) * 16777619UL;
+	}
+	
+	return(myHash);
+}
+
+
+//////////
+//
+// QTShortCut_FindIndexRecord
+// Find the record for the specified file in the specified index; return its number, or -1 if there is none.
+//
+//////////
+
+static long QTShortCut_FindIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr)
+{
+	QTShortCutIndexRecordPtr	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	QTShortCutIndexRecordPtr	myRecord;
+	long						myNumber;
+	
+	if (theIndex->fNumBuckets == 0)
+		return(-1L);
+	
+	myNumber = ((long *)*theIndex->fBuckets)[QTShortCut_HashIndexFile(theFSSpecPtr) & (theIndex->fNumBuckets - 1)];
+	while (myNumber >= 0) {
+		myRecord = &myRecords[myNumber];
+		if ((myRecord->fVRefNum == theFSSpecPtr->vRefNum) && (myRecord->fParID == theFSSpecPtr->parID) &&
+			EqualString((StringPtr)(*theIndex->fPool + myRecord->fNameOffset), theFSSpecPtr->name, false, true))
+			return(myNumber);
+		
+		myNumber = myRecord->fNext;
+	}
+	
+	return(-1L);
+}
+
+
+//////////
+//
+// QTShortCut_AddIndexRecord
+// Add a record for the specified shortcut movie file and its data reference to the specified index; the file
+// mustn't be in the index already.
+//
+//////////
+
+static OSErr QTShortCut_AddIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr, unsigned long theModDate, OSType theDataRefType, Ptr theDataRefPtr, long theDataRefSize)
+{
+	QTShortCutIndexRecord		myRecord;
+	long						*myBucket;
+	long						myPoolSize = theIndex->fPoolSize;
+	OSErr						myErr = noErr;
+	
+	// keep the hash chains short
+	if (theIndex->fNumRecords >= 2 * theIndex->fNumBuckets) {
+		myErr = QTShortCut_RehashShortcutIndex(theIndex, (theIndex->fNumBuckets == 0) ? 256L : 2 * theIndex->fNumBuckets);
+		if (myErr != noErr)
+			return(myErr);
+	}
+	
+	if (!QTShortCut_AddSize(&myPoolSize, theDataRefSize) || !QTShortCut_AddSize(&myPoolSize, theFSSpecPtr->name[0] + 1))
+		return(memFullErr);
+	
+	myErr = QTShortCut_GrowArray(theIndex->fPool, myPoolSize, 1);
+	if (myErr == noErr)
+		myErr = QTShortCut_GrowArray(theIndex->fRecords, theIndex->fNumRecords + 1, sizeof(QTShortCutIndexRecord));
+	if (myErr == noErr)
+		myErr = QTShortCut_GrowArray(theIndex->fOrder, theIndex->fNumRecords + 1, sizeof(long));
+	if (myErr != noErr)
+		return(myErr);
+	
+	myRecord.fDataRefType = theDataRefType;
+	myRecord.fKeyOffset = theIndex->fPoolSize;
+	myRecord.fKeySize = theDataRefSize;
+	myRecord.fNameOffset = theIndex->fPoolSize + theDataRefSize;
+	myRecord.fParID = theFSSpecPtr->parID;
+	myRecord.fModDate = theModDate;
+	myRecord.fVRefNum = theFSSpecPtr->vRefNum;
+	myRecord.fRemoved = false;
+	
+	BlockMoveData(theDataRefPtr, *theIndex->fPool + myRecord.fKeyOffset, theDataRefSize);
+	BlockMoveData(theFSSpecPtr->name, *theIndex->fPool + myRecord.fNameOffset, theFSSpecPtr->name[0] + 1);
+	theIndex->fPoolSize = myPoolSize;
+	
+	myBucket = &((long *)*theIndex->fBuckets)[QTShortCut_HashIndexFile(theFSSpecPtr) & (theIndex->fNumBuckets - 1)];
+	myRecord.fNext = *myBucket;
+	*myBucket = theIndex->fNumRecords;
+	
+	// the new record goes at the end of the list of record numbers, after the part that's sorted
+	((QTShortCutIndexRecordPtr)*theIndex->fRecords)[theIndex->fNumRecords] = myRecord;
+	((long *)*theIndex->fOrder)[theIndex->fNumRecords] = theIndex->fNumRecords;
+	theIndex->fNumRecords++;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_RemoveIndexRecord
+// Remove the record for the specified file from the specified index, if it's there. The record is taken out of the
+// hash table and marked as removed; it stays in the sorted list (and its data in the string pool) until the index
+// is compacted.
+//
+//////////
+
+static void QTShortCut_RemoveIndexRecord (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr)
+{
+	QTShortCutIndexRecordPtr	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	long						*myLink;
+	long						myNumber;
+	
+	myNumber = QTShortCut_FindIndexRecord(theIndex, theFSSpecPtr);
+	if (myNumber < 0)
+		return;
+	
+	myLink = &((long *)*theIndex->fBuckets)[QTShortCut_HashIndexFile(theFSSpecPtr) & (theIndex->fNumBuckets - 1)];
+	while (*myLink != myNumber)
+		myLink = &myRecords[*myLink].fNext;
+	
+	*myLink = myRecords[myNumber].fNext;
+	myRecords[myNumber].fRemoved = true;
+	theIndex->fNumRemoved++;
+}
+
+
+//////////
+//
+// QTShortCut_RehashShortcutIndex
+// Rebuild the hash table of the specified index with the specified number of buckets, which must be a power of two.
+//
+//////////
+
+static OSErr QTShortCut_RehashShortcutIndex (QTShortCutIndexPtr theIndex, long theNumBuckets)
+{
+	QTShortCutIndexRecordPtr	myRecords;
+	long						*myBuckets;
+	long						myBucket;
+	long						myNumber;
+	FSSpec						myFSSpec;
+	OSErr						myErr = noErr;
+	
+	SetHandleSize(theIndex->fBuckets, theNumBuckets * sizeof(long));
+	myErr = MemError();
+	if (myErr != noErr)
+		return(myErr);
+	
+	theIndex->fNumBuckets = theNumBuckets;
+	
+	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	myBuckets = (long *)*theIndex->fBuckets;
+	
+	for (myBucket = 0; myBucket < theNumBuckets; myBucket++)
+		myBuckets[myBucket] = -1L;
+	
+	for (myNumber = 0; myNumber < theIndex->fNumRecords; myNumber++) {
+		if (myRecords[myNumber].fRemoved)
+			continue;
+		
+		myFSSpec.vRefNum = myRecords[myNumber].fVRefNum;
+		myFSSpec.parID = myRecords[myNumber].fParID;
+		BlockMoveData(*theIndex->fPool + myRecords[myNumber].fNameOffset, myFSSpec.name, ((StringPtr)(*theIndex->fPool + myRecords[myNumber].fNameOffset))[0] + 1);
+		
+		myBucket = QTShortCut_HashIndexFile(&myFSSpec) & (theNumBuckets - 1);
+		myRecords[myNumber].fNext = myBuckets[myBucket];
+		myBuckets[myBucket] = myNumber;
+	}
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_SortShortcutIndex
+// Bring the sorted list of record numbers in the specified index up to date: sort the records added since the last
+// call, and merge them into the rest. If removed records make up half the index, the index is compacted first.
+//
+//////////
+
+static OSErr QTShortCut_SortShortcutIndex (QTShortCutIndexPtr theIndex)
+{
+	QTShortCutIndexRecordPtr	myRecords;
+	long						*myOrder;
+	long						*myMerged;
+	Ptr							myPool;
+	long						myNumSorted = theIndex->fNumSorted;
+	long						myNumRecords;
+	long						myLeft;
+	long						myRight;
+	long						myIndex;
+	OSErr						myErr = noErr;
+	
+	if ((theIndex->fNumRemoved > 0) && (2 * theIndex->fNumRemoved >= theIndex->fNumRecords)) {
+		myErr = QTShortCut_CompactShortcutIndex(theIndex);
+		if (myErr != noErr)
+			return(myErr);
+		myNumSorted = theIndex->fNumSorted;
+	}
+	
+	myNumRecords = theIndex->fNumRecords;
+	if (myNumSorted == myNumRecords)
+		return(noErr);
+	
+	// get the scratch memory before dereferencing the handles, since allocating memory may move them
+	myMerged = (long *)QTShortCut_GetScratch(myNumRecords * sizeof(long));
+	
+	myPool = *theIndex->fPool;
+	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	myOrder = (long *)*theIndex->fOrder;
+	
+	// without memory to merge into, just sort the whole list again
+	if (myMerged == NULL) {
+		QTShortCut_SortIndexOrder(myPool, myRecords, myOrder, myNumRecords);
+		theIndex->fNumSorted = myNumRecords;
+		return(noErr);
+	}
+	
+	QTShortCut_SortIndexOrder(myPool, myRecords, myOrder + myNumSorted, myNumRecords - myNumSorted);
+	
+	myLeft = 0L;
+	myRight = myNumSorted;
+	for (myIndex = 0; myIndex < myNumRecords; myIndex++) {
+		if ((myRight >= myNumRecords) || ((myLeft < myNumSorted) && (QTShortCut_CompareIndexKeys(myPool, &myRecords[myOrder[myLeft]], &myRecords[myOrder[myRight]]) <= 0)))
+			myMerged[myIndex] = myOrder[myLeft++];
+		else
+			myMerged[myIndex] = myOrder[myRight++];
+	}
+	
+	BlockMoveData(myMerged, myOrder, myNumRecords * sizeof(long));
+	theIndex->fNumSorted = myNumRecords;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_CompactShortcutIndex
+// Drop the removed records from the specified index, along with their data in the string pool. The records that
+// are left are renumbered in the order of the list of record numbers, so the part of the list that was sorted
+// stays sorted.
+//
+//////////
+
+static OSErr QTShortCut_CompactShortcutIndex (QTShortCutIndexPtr theIndex)
+{
+	QTShortCutIndexRecordPtr	myRecords;
+	QTShortCutIndexRecordPtr	myNewRecords;
+	QTShortCutIndexRecordPtr	myRecord;
+	long						*myOrder;
+	Handle						myNewPool = NULL;
+	Handle						myNewRecordsHandle = NULL;
+	long						myNewPoolSize = 0L;
+	long						myNumSorted = 0L;
+	long						myCount = 0L;
+	long						myIndex;
+	long						myNameSize;
+	
+	myNewPool = NewHandle(theIndex->fPoolSize);
+	if (myNewPool == NULL)
+		return(memFullErr);
+	
+	myNewRecordsHandle = NewHandle((theIndex->fNumRecords - theIndex->fNumRemoved) * sizeof(QTShortCutIndexRecord));
+	if (myNewRecordsHandle == NULL) {
+		DisposeHandle(myNewPool);
+		return(memFullErr);
+	}
+	
+	myRecords = (QTShortCutIndexRecordPtr)*theIndex->fRecords;
+	myNewRecords = (QTShortCutIndexRecordPtr)*myNewRecordsHandle;
+	myOrder = (long *)*theIndex->fOrder;
+	
+	for (myIndex = 0; myIndex < theIndex->fNumRecords; myIndex++) {
+		myRecord = &myRecords[myOrder[myIndex]];
+		if (myRecord->fRemoved)
+			continue;
+		
+		myNameSize = ((StringPtr)(*theIndex->fPool + myRecord->fNameOffset))[0] + 1;
+		
+		myNewRecords[myCount] = *myRecord;
+		myNewRecords[myCount].fKeyOffset = myNewPoolSize;
+		myNewRecords[myCount].fNameOffset = myNewPoolSize + myRecord->fKeySize;
+		BlockMoveData(*theIndex->fPool + myRecord->fKeyOffset, *myNewPool + myNewPoolSize, myRecord->fKeySize);
+		BlockMoveData(*theIndex->fPool + myRecord->fNameOffset, *myNewPool + myNewPoolSize + myRecord->fKeySize, myNameSize);
+		myNewPoolSize += myRecord->fKeySize + myNameSize;
+		
+		if (myIndex < theIndex->fNumSorted)
+			myNumSorted++;
+		
+		myOrder[myCount] = myCount;
+		myCount++;
+	}
+	
+	DisposeHandle(theIndex->fPool);
+	DisposeHandle(theIndex->fRecords);
+	
+	theIndex->fPool = myNewPool;
+	theIndex->fPoolSize = myNewPoolSize;
+	theIndex->fRecords = myNewRecordsHandle;
+	theIndex->fNumRecords = myCount;
+	theIndex->fNumRemoved = 0L;
+	theIndex->fNumSorted = myNumSorted;
+	
+	return(QTShortCut_RehashShortcutIndex(theIndex, theIndex->fNumBuckets));
+}
+
+
+//////////
+//
+// QTShortCut_CompareIndexKeys
+// Compare the data references of two records in a reverse index, byte by byte (a data reference that's a prefix
+// of another comes first); records whose data references are the same are ordered by data reference type.
+//
+//////////
+
+static short QTShortCut_CompareIndexKeys (Ptr thePool, QTShortCutIndexRecordPtr theRecord1, QTShortCutIndexRecordPtr theRecord2)
+{
+	short			myResult;
+	
+	myResult = QTShortCut_CompareKeyToPrefix(thePool + theRecord1->fKeyOffset, theRecord1->fKeySize, thePool + theRecord2->fKeyOffset, theRecord2->fKeySize);
+	if (myResult != 0)
+		return(myResult);
+	
+	// the first data reference begins with the second one, so it comes after it unless they're the same size
+	if (theRecord1->fKeySize != theRecord2->fKeySize)
+		return(1);
+	
+	if (theRecord1->fDataRefType != theRecord2->fDataRefType)
+		return((theRecord1->fDataRefType < theRecord2->fDataRefType) ? -1 : 1);
+	
+	return(0);
+}
+
+
+//////////
+//
+// QTShortCut_CompareKeyToPrefix
+// Compare a data reference with a prefix (or with another data reference), byte by byte; return a negative number
+// if the data reference comes first, and 0 if they're the same, or if the data reference begins with the prefix.
+//
+//////////
+
+static short QTShortCut_CompareKeyToPrefix (Ptr theKey, long theKeySize, Ptr thePrefix, long thePrefixSize)
+{
+	long			myLength = (theKeySize < thePrefixSize) ? theKeySize : thePrefixSize;
+	long			myIndex;
+	
+	for (myIndex = 0; myIndex < myLength; myIndex++)
+		if (theKey[myIndex] != thePrefix[myIndex])
+			return(((unsigned char)theKey[myIndex] < (unsigned char)thePrefix[myIndex]) ? -1 : 1);
+	
+	return((theKeySize < thePrefixSize) ? -1 : 0);
+}
+
+
+//////////
+//
+// QTShortCut_SortIndexOrder
+// Sort the specified list of record numbers so that the data references of the records they refer to are in order
+// (a heap sort, as in QTShortCut_SortNames).
+//
+//////////
+
+static void QTShortCut_SortIndexOrder (Ptr thePool, QTShortCutIndexRecordPtr theRecords, long theOrder[], long theCount)
+{
+	long			myEnd;
+	long			myStart;
+	long			myRoot;
+	long			myChild;
+	long			mySwap;
+	
+	// build the heap, and then repeatedly move the largest remaining data reference to the end
+	for (myStart = theCount / 2; myStart >= 0; myStart--) {
+		for (myRoot = myStart; (myChild = (2 * myRoot) + 1) < theCount; myRoot = myChild) {
+			if ((myChild + 1 < theCount) && (QTShortCut_CompareIndexKeys(thePool, &theRecords[theOrder[myChild]], &theRecords[theOrder[myChild + 1]]) < 0))
+				myChild++;
+			if (QTShortCut_CompareIndexKeys(thePool, &theRecords[theOrder[myRoot]], &theRecords[theOrder[myChild]]) >= 0)
+				break;
+			mySwap = theOrder[myRoot]; theOrder[myRoot] = theOrder[myChild]; theOrder[myChild] = mySwap;
+		}
+	}
+	
+	for (myEnd = theCount - 1; myEnd > 0; myEnd--) {
+		mySwap = theOrder[0]; theOrder[0] = theOrder[myEnd]; theOrder[myEnd] = mySwap;
+		
+		for (myRoot = 0; (myChild = (2 * myRoot) + 1) < myEnd; myRoot = myChild) {
+			if ((myChild + 1 < myEnd) && (QTShortCut_CompareIndexKeys(thePool, &theRecords[theOrder[myChild]], &theRecords[theOrder[myChild + 1]]) < 0))
+				myChild++;
+			if (QTShortCut_CompareIndexKeys(thePool, &theRecords[theOrder[myRoot]], &theRecords[theOrder[myChild]]) >= 0)
+				break;
+			mySwap = theOrder[myRoot]; theOrder[myRoot] = theOrder[myChild]; theOrder[myChild] = mySwap;
+		}
+	}
+}
+
+
+//////////
+//
+// QTShortCut_NewTreeReader
+// Prepare a tree reader, which reads the files handed to it by QTShortCut_SubmitTreeRead with up to theMaxInFlight
+// reads outstanding at once, and passes the data of each file to theProc as soon as it has been read.
+//
+// On the Mac, each file is read with a chain of asynchronous File Manager calls (open, read, close), in the manner
+// of QTShortCut_CreateShortcutMovieFilesAsync, so the reads overlap with each other and with the scan of the folders
+// that supplies the files. Each read has its own buffer, which is reused from one file to the next. On Windows, or
+// if theMaxInFlight is 1, each file is read (and passed to theProc) before QTShortCut_SubmitTreeRead returns.
+//
+//////////
+
+static OSErr QTShortCut_NewTreeReader (QTShortCutTreeReaderPtr theReader, short theMaxInFlight, QTShortCutTreeReadProcPtr theProc, void *theRefCon)
+{
+	short			myIndex;
+	
+#if TARGET_OS_MAC	
+	if (theMaxInFlight > kShortcutMaxReadsInFlight)
+		theMaxInFlight = kShortcutMaxReadsInFlight;
+	if (theMaxInFlight < 1)
+		theMaxInFlight = 1;
+#else
+	theMaxInFlight = 1;
+#endif	// TARGET_OS_MAC	
+	
+	theReader->fNumReads = theMaxInFlight;
+	theReader->fProc = theProc;
+	theReader->fRefCon = theRefCon;
+	theReader->fErr = noErr;
+	
+	theReader->fReads = (QTShortCutTreeReadPtr)NewPtrClear(theMaxInFlight * sizeof(QTShortCutTreeRead));
+	if (theReader->fReads == NULL)
+		return(MemError());
+	
+	for (myIndex = 0; myIndex < theMaxInFlight; myIndex++) {
+		theReader->fReads[myIndex].fData = NewHandle(0);
+		if (theReader->fReads[myIndex].fData == NULL) {
+			QTShortCut_DisposeTreeReader(theReader);
+			return(memFullErr);
+		}
+	}
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_SubmitTreeRead
+// Start reading the specified file with the specified tree reader, once one of its reads is free; at most
+// kShortcutMaxScanSize bytes are read from the beginning of the file. The function result is the first error
+// returned by the reader's procedure, if there has been one; no more files are read after that.
+//
+//////////
+
+static OSErr QTShortCut_SubmitTreeRead (QTShortCutTreeReaderPtr theReader, FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate)
+{
+	QTShortCutTreeReadPtr	myRead = NULL;
+	short					myIndex;
+	
+	// wait for a free read, passing on the data of any reads that finish in the meantime
+	while ((myRead == NULL) && (theReader->fErr == noErr)) {
+		for (myIndex = 0; (myIndex < theReader->fNumReads) && (myRead == NULL); myIndex++) {
+			QTShortCutTreeReadPtr	myCandidate = &theReader->fReads[myIndex];
+			
+			if (myCandidate->fBusy && QTShortCut_ContinueTreeRead(myCandidate))
+				QTShortCut_DeliverTreeRead(theReader, myCandidate);
+			if (!myCandidate->fBusy)
+				myRead = myCandidate;
+		}
+	}
+	
+	if (theReader->fErr != noErr)
+		return(theReader->fErr);
+	
+	myRead->fFSSpec = *theFSSpecPtr;
+	myRead->fFileSize = theSize;
+	myRead->fModDate = theModDate;
+	myRead->fDataSize = (theSize < kShortcutMaxScanSize) ? theSize : kShortcutMaxScanSize;
+	myRead->fErr = noErr;
+	myRead->fBusy = true;
+	
+	SetHandleSize(myRead->fData, myRead->fDataSize);
+	myRead->fErr = MemError();
+	HLock(myRead->fData);
+	
+#if TARGET_OS_MAC	
+	if (theReader->fNumReads > 1) {
+		QTShortCut_StartTreeRead(myRead);
+		return(noErr);
+	}
+#endif	// TARGET_OS_MAC	
+	
+	// read the file now
+	if ((myRead->fErr == noErr) && (myRead->fDataSize > 0)) {
+		short		myRefNum = 0;
+		
+		myRead->fErr = FSpOpenDF(&myRead->fFSSpec, fsRdPerm, &myRefNum);
+		if (myRead->fErr == noErr) {
+			myRead->fErr = FSRead(myRefNum, &myRead->fDataSize, *myRead->fData);
+			if (myRead->fErr == eofErr)
+				myRead->fErr = noErr;
+			FSClose(myRefNum);
+		}
+	}
+	
+	QTShortCut_DeliverTreeRead(theReader, myRead);
+	
+	return(theReader->fErr);
+}
+
+
+//////////
+//
+// QTShortCut_FinishTreeReads
+// Wait for the outstanding reads of the specified tree reader to finish, and pass on their data; the function
+// result is the first error returned by the reader's procedure, if there has been one.
+//
+//////////
+
+static OSErr QTShortCut_FinishTreeReads (QTShortCutTreeReaderPtr theReader)
+{
+	Boolean			myAnyBusy = true;
+	short			myIndex;
+	
+	while (myAnyBusy) {
+		myAnyBusy = false;
+		for (myIndex = 0; myIndex < theReader->fNumReads; myIndex++) {
+			QTShortCutTreeReadPtr	myRead = &theReader->fReads[myIndex];
+			
+			if (myRead->fBusy && QTShortCut_ContinueTreeRead(myRead))
+				QTShortCut_DeliverTreeRead(theReader, myRead);
+			if (myRead->fBusy)
+				myAnyBusy = true;
+		}
+	}
+	
+	return(theReader->fErr);
+}
+
+
+//////////
+//
+// QTShortCut_DeliverTreeRead
+// Pass the data of the specified read, which has finished, to the procedure of the specified tree reader
+// (unless the procedure has already returned an error), and free the read for the next file.
+//
+//////////
+
+static void QTShortCut_DeliverTreeRead (QTShortCutTreeReaderPtr theReader, QTShortCutTreeReadPtr theRead)
+{
+	OSErr			myErr = noErr;
+	
+	if (theReader->fErr == noErr) {
+		myErr = (*theReader->fProc)(&theRead->fFSSpec, *theRead->fData, theRead->fDataSize, theRead->fFileSize, theRead->fModDate, theRead->fErr, theReader->fRefCon);
+		if (myErr != noErr)
+			theReader->fErr = myErr;
+	}
+	
+	HUnlock(theRead->fData);
+	theRead->fBusy = false;
+}
+
+
+//////////
+//
+// QTShortCut_DisposeTreeReader
+// Dispose of the memory used by the specified tree reader, which mustn't have any reads outstanding.
+//
+//////////
+
+static void QTShortCut_DisposeTreeReader (QTShortCutTreeReaderPtr theReader)
+{
+	short			myIndex;
+	
+	if (theReader->fReads == NULL)
+		return;
+	
+	for (myIndex = 0; myIndex < theReader->fNumReads; myIndex++)
+		if (theReader->fReads[myIndex].fData != NULL)
+			DisposeHandle(theReader->fReads[myIndex].fData);
+	
+	DisposePtr((Ptr)theReader->fReads);
+	theReader->fReads = NULL;
+}
+
+
+//////////
+//
+// QTShortCut_ContinueTreeRead
+// If the outstanding File Manager call for the specified read has completed, issue the next one;
+// return true if the read is done (successfully or not), and false if it is still in progress.
+//
+//////////
+
+static Boolean QTShortCut_ContinueTreeRead (QTShortCutTreeReadPtr theRead)
+{
+#if TARGET_OS_MAC	
+	HParmBlkPtr		myPB = &theRead->fParamBlock;
+	OSErr			myErr;
+	
+	if (theRead->fStep == kAsyncReadStepDone)
+		return(true);
+	
+	// a positive result means that the call is still in progress
+	myErr = myPB->ioParam.ioResult;
+	if (myErr > 0)
+		return(false);
+	
+	// the file may have got shorter since the folder was scanned; ioActCount tells us how much we got
+	if ((theRead->fStep == kAsyncReadStepRead) && (myErr == eofErr))
+		myErr = noErr;
+	
+	if (myErr != noErr) {
+		if (theRead->fErr == noErr)
+			theRead->fErr = myErr;
+		
+		// if something went wrong after we opened the file, close it anyway
+		if ((theRead->fRefNum != 0) && (theRead->fStep != kAsyncReadStepClose)) {
+			theRead->fStep = kAsyncReadStepClose;
+			myPB->ioParam.ioRefNum = theRead->fRefNum;
+			PBCloseAsync((ParmBlkPtr)myPB);
+			return(false);
+		}
+		
+		theRead->fStep = kAsyncReadStepDone;
+		return(true);
+	}
+	
+	switch (theRead->fStep) {
+		case kAsyncReadStepOpen:
+			theRead->fRefNum = myPB->ioParam.ioRefNum;
+			myPB->ioParam.ioBuffer = *theRead->fData;
+			myPB->ioParam.ioReqCount = theRead->fDataSize;
+			myPB->ioParam.ioPosMode = fsFromStart;
+			myPB->ioParam.ioPosOffset = 0;
+			PBReadAsync((ParmBlkPtr)myPB);
+			break;
+			
+		case kAsyncReadStepRead:
+			theRead->fDataSize = myPB->ioParam.ioActCount;
+			myPB->ioParam.ioRefNum = theRead->fRefNum;
+			PBCloseAsync((ParmBlkPtr)myPB);
+			break;
+			
+		case kAsyncReadStepClose:
+		default:
+			theRead->fRefNum = 0;
+			theRead->fStep = kAsyncReadStepDone;
+			return(true);
+	}
+	
+	theRead->fStep++;
+	
+	return(false);
+#else
+	return(true);
+#endif	// TARGET_OS_MAC	
+}
+
+
+//////////
+//
+// QTShortCut_ValidateScanFile
+// Start reading the specified shortcut movie file, as part of a call to QTShortCut_ValidateShortcutFolder.
+//
+//////////
+
+static OSErr QTShortCut_ValidateScanFile (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon)
+{
+	QTShortCutValidateScanPtr	myScan = (QTShortCutValidateScanPtr)theRefCon;
+	
+	myScan->fStats->fNumScanned++;
+	
+	return(QTShortCut_SubmitTreeRead(&myScan->fReader, theFSSpecPtr, theSize, theModDate));
+}
+
+
+//////////
+//
+// QTShortCut_ValidateFileData
+// Check the shortcut movie file that has just been read, as part of a call to QTShortCut_ValidateShortcutFolder,
+// and report it if it has a problem.
+//
+//////////
+
+static OSErr QTShortCut_ValidateFileData (FSSpecPtr theFSSpecPtr, Ptr theData, long theDataSize, long theFileSize, unsigned long theModDate, OSErr theErr, void *theRefCon)
+{
+	QTShortCutValidateScanPtr	myScan = (QTShortCutValidateScanPtr)theRefCon;
+	QTShortCutValidateStatsPtr	myStats = myScan->fStats;
+	OSType						myDataRefType;
+	Ptr							myDataRefPtr;
+	long						myDataRefSize;
+	short						myProblem = kShortcutValid;
+	OSErr						myErr = theErr;
+	
+	if (theErr != noErr) {
+		myProblem = kShortcutUnreadable;
+	} else {
+		QTShortCut_AddToWide(&myStats->fNumBytes, (unsigned long)theDataSize);
+		
+		// the file may have got shorter since the folder was scanned; if we got less than we asked for, we got it all
+		if ((theDataSize < theFileSize) && (theDataSize < kShortcutMaxScanSize))
+			theFileSize = theDataSize;
+		
+		myProblem = QTShortCut_CheckShortcutData(theData, theDataSize, theFileSize, &myDataRefType, &myDataRefPtr, &myDataRefSize);
+		
+#if TARGET_OS_MAC	
+		// the alias is copied from the data, so it's looked up only if the whole file was read
+		if ((myProblem == kShortcutValid) && (myScan->fAlias != NULL) && (myDataRefType == rAliasType) && (theDataSize >= theFileSize)) {
+			myErr = QTShortCut_CheckAliasTarget(theFSSpecPtr, myScan->fAlias, myDataRefPtr, myDataRefSize);
+			if (myErr == memFullErr)
+				return(myErr);
+			if (myErr != noErr)
+				myProblem = kShortcutDangling;
+		}
+#endif	// TARGET_OS_MAC	
+	}
+	
+	switch (myProblem) {
+		case kShortcutValid:			myStats->fNumValid++;			break;
+		case kShortcutMalformed:		myStats->fNumMalformed++;		break;
+		case kShortcutTruncated:		myStats->fNumTruncated++;		break;
+		case kShortcutUnknownType:		myStats->fNumUnknownType++;		break;
+		case kShortcutDangling:			myStats->fNumDangling++;		break;
+		case kShortcutNotShortcut:		myStats->fNumSkipped++;			return(noErr);
+		case kShortcutUnreadable:
+		default:						myStats->fNumErrors++;			break;
+	}
+	
+	if ((myProblem != kShortcutValid) && (myScan->fProc != NULL))
+		return((*myScan->fProc)(theFSSpecPtr, myProblem, myErr, myScan->fRefCon));
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_CheckShortcutData
+// Check the layout of a shortcut movie file theFileSize bytes long, whose first theDataSize bytes are in theData,
+// and return kShortcutValid, the problem found, or kShortcutNotShortcut if the file is an ordinary movie.
+// This is stricter than QTShortCut_ParseShortcutData, and tells a file that's been cut short from one that was
+// never right; but like it, it allocates nothing, and on success theDataRefPtr points into theData. The data
+// reference itself is checked only if all of it is in theData.
+//
+//////////
+
+static short QTShortCut_CheckShortcutData (Ptr theData, long theDataSize, long theFileSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize)
+{
+	OSType				myAtomTypes[3];
+	unsigned long		myAtomSize;
+	long				myHeaderSize;
+	long				myOffset = 0L;
+	long				myIndex;
+	
+	myAtomTypes[0] = MovieAID;
+	myAtomTypes[1] = MovieDataRefAliasAID;
+	myAtomTypes[2] = DataRefAID;
+	
+	// an ordinary movie begins with some other atom, or has a movie atom that begins with a movie header atom;
+	// look at the first two atom types before checking any sizes, since an ordinary movie atom doesn't fill the file
+	for (myIndex = 0; myIndex < 2; myIndex++) {
+		if ((theFileSize - myOffset < kRefMovieAtomHeaderSize) || (theDataSize - myOffset < kRefMovieAtomHeaderSize))
+			return(kShortcutTruncated);
+		if (QTShortCut_GetBigEndianLong(theData + myOffset + kShortcutFieldSize) != myAtomTypes[myIndex])
+			return(kShortcutNotShortcut);
+		
+		myOffset += (QTShortCut_GetBigEndianLong(theData + myOffset) == 1) ? kExtendedAtomHeaderSize : kRefMovieAtomHeaderSize;
+	}
+	
+	// each atom must fill the rest of the atom that contains it, and so must end exactly at the end of the file
+	myOffset = 0L;
+	for (myIndex = 0; myIndex < 3; myIndex++) {
+		myHeaderSize = kRefMovieAtomHeaderSize;
+		if ((theFileSize - myOffset < myHeaderSize) || (theDataSize - myOffset < myHeaderSize))
+			return(kShortcutTruncated);
+		
+		if (QTShortCut_GetBigEndianLong(theData + myOffset + kShortcutFieldSize) != myAtomTypes[myIndex])
+			return(kShortcutMalformed);
+		
+		myAtomSize = QTShortCut_GetBigEndianLong(theData + myOffset);
+		if (myAtomSize == 0) {
+			// the atom extends to the end of the file
+			myAtomSize = theFileSize - myOffset;
+		} else if (myAtomSize == 1) {
+			myHeaderSize = kExtendedAtomHeaderSize;
+			if ((theFileSize - myOffset < myHeaderSize) || (theDataSize - myOffset < myHeaderSize))
+				return(kShortcutTruncated);
+			
+			// a size with any of the high 32 bits set is longer than any file we can read
+			if (QTShortCut_GetBigEndianLong(theData + myOffset + (2 * kShortcutFieldSize)) != 0)
+				return(kShortcutTruncated);
+			myAtomSize = QTShortCut_GetBigEndianLong(theData + myOffset + (3 * kShortcutFieldSize));
+		}
+		
+		if (myAtomSize < (unsigned long)myHeaderSize)
+			return(kShortcutMalformed);
+		if (myAtomSize > (unsigned long)(theFileSize - myOffset))
+			return(kShortcutTruncated);
+		if (myAtomSize < (unsigned long)(theFileSize - myOffset))
+			return(kShortcutMalformed);
+		
+		myOffset += myHeaderSize;
+	}
+	
+	// the data reference atom must have room for the data reference type
+	if ((theFileSize - myOffset < kShortcutFieldSize) || (theDataSize - myOffset < kShortcutFieldSize))
+		return(kShortcutMalformed);
+	
+	*theDataRefType = QTShortCut_GetBigEndianLong(theData + myOffset);
+	*theDataRefPtr = theData + myOffset + kShortcutFieldSize;
+	*theDataRefSize = theFileSize - (myOffset + kShortcutFieldSize);
+	
+	if ((*theDataRefType != rAliasType) && (*theDataRefType != URLDataHandlerSubType))
+		return(kShortcutUnknownType);
+	
+	if (theDataSize < theFileSize)
+		return(kShortcutValid);
+	
+	if (*theDataRefType == rAliasType) {
+		// an alias record begins with its user type and its size, which covers the whole record
+		if ((*theDataRefSize < (long)(kShortcutFieldSize + sizeof(short))) ||
+			(QTShortCut_GetBigEndianShort(*theDataRefPtr + kShortcutFieldSize) < kShortcutFieldSize + sizeof(short)) ||
+			(QTShortCut_GetBigEndianShort(*theDataRefPtr + kShortcutFieldSize) > *theDataRefSize))
+			return(kShortcutMalformed);
+	} else {
+		// a URL is a C string, perhaps followed by padding (see QTShortCut_RetargetFile)
+		if ((*theDataRefSize == 0) || ((*theDataRefPtr)[0] == 0))
+			return(kShortcutMalformed);
+		
+		for (myIndex = 1; myIndex < *theDataRefSize; myIndex++)
+			if ((*theDataRefPtr)[myIndex] == 0)
+				break;
+		
+		if (myIndex == *theDataRefSize)
+			return(kShortcutMalformed);
+	}
+	
+	return(kShortcutValid);
+}
+
+
+#if TARGET_OS_MAC	
+
+//////////
+//
+// QTShortCut_InitVolumeList
+// Prepare the specified list of volumes for a batch that uses the specified flush policy.
+//
+//////////
+
+static void QTShortCut_InitVolumeList (QTShortCutVolumeListPtr theVolumes, short thePolicy)
+{
+	theVolumes->fPolicy = thePolicy;
+	theVolumes->fNumVolumes = 0;
+	theVolumes->fLastVRefNum = 0;
+	theVolumes->fLastDirID = 0L;
+}
+
+
+//////////
+//
+// QTShortCut_RememberFile
+// Note that the specified file has been written during a batch, and flush any volumes
+// that the batch flush policy says should be flushed now.
+//
+// Under kShortcutFlushAtEndOfBatch, we keep a list of the volumes written to; if the list is already full,
+// we just flush the file's volume now. Under kShortcutFlushPerFolder, the list holds at most the volume of
+// the most recent folder, which is flushed when a file in a different folder comes along.
+//
+//////////
+
+static OSErr QTShortCut_RememberFile (QTShortCutVolumeListPtr theVolumes, FSSpecPtr theFSSpecPtr)
+{
+	OSErr			myErr = noErr;
+	
+	switch (theVolumes->fPolicy) {
+		case kShortcutFlushAtEndOfBatch:
+			myErr = QTShortCut_RememberVolume(theVolumes, theFSSpecPtr->vRefNum);
+			break;
+			
+		case kShortcutFlushPerFolder:
+			if ((theVolumes->fNumVolumes > 0) && ((theVolumes->fLastVRefNum != theFSSpecPtr->vRefNum) || (theVolumes->fLastDirID != theFSSpecPtr->parID)))
+				myErr = QTShortCut_FlushVolumes(theVolumes);
+			
+			theVolumes->fVolumes[0] = theFSSpecPtr->vRefNum;
+			theVolumes->fNumVolumes = 1;
+			theVolumes->fLastVRefNum = theFSSpecPtr->vRefNum;
+			theVolumes->fLastDirID = theFSSpecPtr->parID;
+			break;
+			
+		default:
+			// there's nothing to do at the batch level for the other policies
+			break;
+	}
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_RememberVolume
+// Add the specified volume to the specified list, if it isn't already there; if the list is full, flush the volume now.
+//
+//////////
+
+static OSErr QTShortCut_RememberVolume (QTShortCutVolumeListPtr theVolumes, short theVRefNum)
+{
+	short			myIndex;
+	
+	for (myIndex = 0; myIndex < theVolumes->fNumVolumes; myIndex++)
+		if (theVolumes->fVolumes[myIndex] == theVRefNum)
+			return(noErr);
+	
+	if (theVolumes->fNumVolumes < kShortcutMaxBatchVolumes) {
+		theVolumes->fVolumes[theVolumes->fNumVolumes++] = theVRefNum;
+		return(noErr);
+	}
+	
+	return(FlushVol(NULL, theVRefNum));
+}
+
+
+//////////
+//
+// QTShortCut_FlushVolumes
+// Flush each volume in the specified list, and empty the list.
+//
+//////////
+
+static OSErr QTShortCut_FlushVolumes (QTShortCutVolumeListPtr theVolumes)
+{
+	short			myIndex;
+	OSErr			myVolErr = noErr;
+	OSErr			myErr = noErr;
+	
+	for (myIndex = 0; myIndex < theVolumes->fNumVolumes; myIndex++) {
+		myVolErr = FlushVol(NULL, theVolumes->fVolumes[myIndex]);
+		if (myErr == noErr)
+			myErr = myVolErr;
+	}
+	
+	theVolumes->fNumVolumes = 0;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_StartAsyncWrite
+// Begin writing a shortcut to the specified data reference into the specified file, using asynchronous File
+// Manager calls; call QTShortCut_ContinueAsyncWrite repeatedly until it returns true, and then look at fErr.
+//
+// The data reference stays locked, and the FSSpec must stay put, until the write is done.
+//
+//////////
+
+static void QTShortCut_StartAsyncWrite (QTShortCutAsyncWritePtr theWrite, Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr, short theFlushPolicy)
+{
+	theWrite->fRefNum = 0;
+	theWrite->fFSSpecPtr = theFSSpecPtr;
+	theWrite->fAtomic = ((gWriteFlags & kShortcutWriteAtomicReplace) != 0);
+	theWrite->fFlushPolicy = theFlushPolicy;
+	theWrite->fDataRef = theDataRef;
+	theWrite->fErr = noErr;
+	
+	if ((theDataRef == NULL) || (GetHandleSize(theDataRef) > kShortcutMaxFileSize - kShortcutHeaderSize)) {
+		theWrite->fErr = paramErr;
+		theWrite->fStep = kAsyncWriteStepDone;
+		return;
+	}
+
+	QTShortCut_FillShortcutHeader(GetHandleSize(theDataRef), theDataRefType, (Ptr)theWrite->fHeader);
+
+	// when replacing the file atomically, all the steps up to closing the file act on a temporary file
+	if (theWrite->fAtomic) {
+		theWrite->fErr = QTShortCut_MakeTempFSSpec(theFSSpecPtr, &theWrite->fTempFSSpec);
+		if (theWrite->fErr != noErr) {
+			theWrite->fStep = kAsyncWriteStepDone;
+			return;
+		}
+		theFSSpecPtr = &theWrite->fTempFSSpec;
+	}
+	
+	theWrite->fDataRefState = HGetState(theDataRef);
+	HLock(theDataRef);
+	
+	// delete the file; if it doesn't exist yet, we'll get an error (fnfErr), which we just ignore
+	theWrite->fParamBlock.fileParam.ioCompletion = NULL;
+	theWrite->fStep = kAsyncWriteStepDelete;
+	QTShortCut_IssueAsyncDelete(theWrite, theFSSpecPtr);
+}
+
+
+//////////
+//
+// QTShortCut_ContinueAsyncWrite
+// If the outstanding File Manager call for the specified write has completed, issue the next one;
+// return true if the write is done (successfully or not), and false if it is still in progress.
+//
+//////////
+
+static Boolean QTShortCut_ContinueAsyncWrite (QTShortCutAsyncWritePtr theWrite)
+{
+	HParmBlkPtr		myPB = &theWrite->fParamBlock;
+	OSErr			myErr;
+
+	if (theWrite->fStep == kAsyncWriteStepDone)
+		return(true);
+	
+	// a positive result means that the call is still in progress
+	myErr = myPB->fileParam.ioResult;
+	if (myErr > 0)
+		return(false);
+	
+	if ((theWrite->fStep == kAsyncWriteStepDelete) && (myErr == fnfErr))
+		myErr = noErr;
+	
+	// any error deleting the target file is ignored; renaming the temporary file tells us whether we succeeded
+	if (theWrite->fStep == kAsyncWriteStepDeleteTarget)
+		myErr = noErr;
+	
+	// if the volume can't exchange the files, delete the target file and rename the temporary file instead;
+	// if the target file doesn't exist yet (fnfErr), just rename the temporary file
+	if ((theWrite->fStep == kAsyncWriteStepExchange) && (myErr != noErr)) {
+		if (myErr == fnfErr) {
+			QTShortCut_IssueAsyncRename(theWrite);
+		} else {
+			theWrite->fStep = kAsyncWriteStepDeleteTarget;
+			QTShortCut_IssueAsyncDelete(theWrite, theWrite->fFSSpecPtr);
+		}
+		return(false);
+	}
+	
+	if (myErr != noErr) {
+		if (theWrite->fErr == noErr)
+			theWrite->fErr = myErr;
+		
+		// if we can't get rid of the temporary file or flush the volume, there's nothing more we can do
+		if ((theWrite->fStep == kAsyncWriteStepDeleteTemp) || (theWrite->fStep == kAsyncWriteStepFlushVolume))
+			goto done;
+		
+		// if something went wrong after we opened the file, close it anyway
+		if ((theWrite->fRefNum != 0) && (theWrite->fStep != kAsyncWriteStepClose)) {
+			theWrite->fStep = kAsyncWriteStepClose;
+			myPB->ioParam.ioRefNum = theWrite->fRefNum;
+			PBCloseAsync((ParmBlkPtr)myPB);
+			return(false);
+		}
+		
+		theWrite->fStep = kAsyncWriteStepClose;
+	}
+
+	switch (theWrite->fStep) {
+		case kAsyncWriteStepDelete:
+			// create the file
+			PBHCreateAsync(myPB);
+			break;
+
+		case kAsyncWriteStepCreate:
+			// get the file's Finder information, so that we can set its type and creator
+			myPB->fileParam.ioFDirIndex = 0;
+			PBHGetFInfoAsync(myPB);
+			break;
+
+		case kAsyncWriteStepGetInfo:
+			myPB->fileParam.ioFlFndrInfo.fdType = kShortcutFileType;
+			myPB->fileParam.ioFlFndrInfo.fdCreator = kShortcutFileCreator;
+			myPB->fileParam.ioDirID = theWrite->fFSSpecPtr->parID;
+			PBHSetFInfoAsync(myPB);
+			break;
+
+		case kAsyncWriteStepSetInfo:
+			// open the file's data fork
+			myPB->ioParam.ioPermssn = fsRdWrPerm;
+			myPB->ioParam.ioMisc = NULL;
+			PBHOpenDFAsync(myPB);
+			break;
+
+		case kAsyncWriteStepOpen:
+			// the file is new and empty, so we can just write the atom headers and then the data reference
+			theWrite->fRefNum = myPB->ioParam.ioRefNum;
+			myPB->ioParam.ioBuffer = (Ptr)theWrite->fHeader;
+			myPB->ioParam.ioReqCount = kShortcutHeaderSize;
+			myPB->ioParam.ioPosMode = fsFromStart;
+			myPB->ioParam.ioPosOffset = 0;
+			PBWriteAsync((ParmBlkPtr)myPB);
+			break;
+
+		case kAsyncWriteStepWriteHeader:
+			myPB->ioParam.ioBuffer = *theWrite->fDataRef;
+			myPB->ioParam.ioReqCount = GetHandleSize(theWrite->fDataRef);
+			myPB->ioParam.ioPosMode = fsAtMark;
+			myPB->ioParam.ioPosOffset = 0;
+			if (myPB->ioParam.ioReqCount > 0) {
+				PBWriteAsync((ParmBlkPtr)myPB);
+				break;
+			}
+			theWrite->fStep++;
+			// fall through if the data reference is empty
+
+		case kAsyncWriteStepWriteDataRef:
+			if (theWrite->fFlushPolicy == kShortcutFlushPerFile) {
+				// flush the file's data to disk before closing it
+				myPB->ioParam.ioRefNum = theWrite->fRefNum;
+				PBFlushFileAsync((ParmBlkPtr)myPB);
+				break;
+			}
+			theWrite->fStep++;
+			// fall through to close the file
+
+		case kAsyncWriteStepFlushFile:
+			myPB->ioParam.ioRefNum = theWrite->fRefNum;
+			PBCloseAsync((ParmBlkPtr)myPB);
+			break;
+
+		case kAsyncWriteStepClose:
+			theWrite->fRefNum = 0;
+			if (theWrite->fAtomic && (theWrite->fErr == noErr)) {
+				// swap the contents of the temporary file and the target file
+				FIDParam *		myFIDPB = (FIDParam *)myPB;
+				
+				myFIDPB->ioNamePtr = theWrite->fTempFSSpec.name;
+				myFIDPB->ioVRefNum = theWrite->fTempFSSpec.vRefNum;
+				myFIDPB->ioSrcDirID = theWrite->fTempFSSpec.parID;
+				myFIDPB->ioDestNamePtr = theWrite->fFSSpecPtr->name;
+				myFIDPB->ioDestDirID = theWrite->fFSSpecPtr->parID;
+				PBExchangeFilesAsync((ParmBlkPtr)myPB);
+				break;
+			} else if (theWrite->fAtomic) {
+				// the temporary file is closed, but something went wrong; get rid of it
+				theWrite->fStep = kAsyncWriteStepDeleteTemp;
+				QTShortCut_IssueAsyncDelete(theWrite, &theWrite->fTempFSSpec);
+				return(false);
+			}
+			goto done;
+			
+		case kAsyncWriteStepExchange:
+			// the temporary file now holds the old data; get rid of it
+			theWrite->fStep = kAsyncWriteStepDeleteTemp;
+			QTShortCut_IssueAsyncDelete(theWrite, &theWrite->fTempFSSpec);
+			return(false);
+			
+		case kAsyncWriteStepDeleteTarget:
+			QTShortCut_IssueAsyncRename(theWrite);
+			return(false);
+
+		case kAsyncWriteStepDeleteTemp:
+		case kAsyncWriteStepRename:
+			goto done;
+
+		case kAsyncWriteStepFlushVolume:
+		default:
+			goto finish;
+	}
+	
+	theWrite->fStep++;
+
+	return(false);
+
+done:
+	// flush the volume, if the flush policy calls for it
+	if ((theWrite->fErr == noErr) && (theWrite->fFlushPolicy == kShortcutFlushVolumePerFile)) {
+		myPB->volumeParam.ioNamePtr = NULL;
+		myPB->volumeParam.ioVRefNum = theWrite->fFSSpecPtr->vRefNum;
+		theWrite->fStep = kAsyncWriteStepFlushVolume;
+		PBFlushVolAsync((ParmBlkPtr)myPB);
+		return(false);
+	}
+
+finish:
+	theWrite->fStep = kAsyncWriteStepDone;
+	HSetState(theWrite->fDataRef, theWrite->fDataRefState);
+	QTShortCut_InvalidateShortcutCache(theWrite->fFSSpecPtr);
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_IssueAsyncDelete
+// Start deleting the specified file, as a step in the specified asynchronous write.
+//
+//////////
+
+static void QTShortCut_IssueAsyncDelete (QTShortCutAsyncWritePtr theWrite, FSSpecPtr theFSSpecPtr)
+{
+	HParmBlkPtr		myPB = &theWrite->fParamBlock;
+
+	myPB->fileParam.ioNamePtr = theFSSpecPtr->name;
+	myPB->fileParam.ioVRefNum = theFSSpecPtr->vRefNum;
+	myPB->fileParam.ioDirID = theFSSpecPtr->parID;
+	myPB->fileParam.ioFVersNum = 0;
+	myPB->fileParam.ioFDirIndex = 0;
+	PBHDeleteAsync(myPB);
+}
+
+
+//////////
+//
+// QTShortCut_IssueAsyncRename
+// Start giving the temporary file the name of the target file, as a step in the specified asynchronous write.
+//
+//////////
+
+static void QTShortCut_IssueAsyncRename (QTShortCutAsyncWritePtr theWrite)
+{
+	HParmBlkPtr		myPB = &theWrite->fParamBlock;
+
+	myPB->ioParam.ioNamePtr = theWrite->fTempFSSpec.name;
+	myPB->ioParam.ioVRefNum = theWrite->fTempFSSpec.vRefNum;
+	myPB->ioParam.ioMisc = (Ptr)theWrite->fFSSpecPtr->name;
+	myPB->fileParam.ioDirID = theWrite->fTempFSSpec.parID;
+	
+	theWrite->fStep = kAsyncWriteStepRename;
+	PBHRenameAsync(myPB);
+}
+
+
+//////////
+//
+// QTShortCut_GetNextWorkItem
+// Get the index of the next item that the specified worker should process, stealing work from
+// another worker if necessary; return false if there is no work left.
+//
+// Since the workers are cooperative threads, no other worker can run while we do this.
+//
+//////////
+
+static Boolean QTShortCut_GetNextWorkItem (QTShortCutWorkerPtr theWorker, long *theIndex)
+{
+	QTShortCutEnginePtr		myEngine = theWorker->fEngine;
+	QTShortCutWorkerPtr		myVictim = NULL;
+	long					myRemaining = 0;
+	long					mySplit;
+	short					myIndex;
+	
+	if (theWorker->fNext >= theWorker->fEnd) {
+		// find the worker with the most work left
+		for (myIndex = 0; myIndex < myEngine->fNumWorkers; myIndex++) {
+			QTShortCutWorkerPtr		myWorker = &myEngine->fWorkers[myIndex];
+			
+			if (myWorker->fEnd - myWorker->fNext > myRemaining) {
+				myRemaining = myWorker->fEnd - myWorker->fNext;
+				myVictim = myWorker;
+			}
+		}
+		
+		if (myVictim == NULL)
+			return(false);
+		
+		// take the second half of its range; if it has only one item left, take that
+		mySplit = myVictim->fNext + (myRemaining / 2);
+		theWorker->fNext = mySplit;
+		theWorker->fEnd = myVictim->fEnd;
+		myVictim->fEnd = mySplit;
+	}
+	
+	*theIndex = theWorker->fNext++;
+	
+	return(true);
+}
+
+
+//////////
+//
+// QTShortCut_WorkerThread
+// The entry point of a worker thread used by QTShortCut_CreateShortcutMovieFilesInParallel.
+//
+//////////
+
+static pascal voidPtr QTShortCut_WorkerThread (void *theParam)
+{
+	QTShortCutWorkerPtr		myWorker = (QTShortCutWorkerPtr)theParam;
+	QTShortCutEnginePtr		myEngine = myWorker->fEngine;
+	long					myIndex;
+	OSErr					myErr;
+
+	while (QTShortCut_GetNextWorkItem(myWorker, &myIndex)) {
+		QTShortCut_StartAsyncWrite(&myWorker->fWrite, myEngine->fDataRefs[myIndex], myEngine->fDataRefTypes[myIndex], &myEngine->fFSSpecs[myIndex], myWorker->fVolumes.fPolicy);
+		
+		while (!QTShortCut_ContinueAsyncWrite(&myWorker->fWrite))
+			YieldToAnyThread();
+		
+		myErr = myWorker->fWrite.fErr;
+		if (myErr == noErr)
+			myErr = QTShortCut_RememberFile(&myWorker->fVolumes, &myEngine->fFSSpecs[myIndex]);
+
+		if (myEngine->fErrors != NULL)
+			myEngine->fErrors[myIndex] = myErr;
+		
+		if ((myEngine->fErr == noErr) && (myErr != noErr))
+			myEngine->fErr = myErr;
+	}
+	
+	myWorker->fDone = true;
+	
+	return(NULL);
+}
+
+
+//////////
+//
+// QTShortCut_StartTreeRead
+// Start reading the file of the specified read, by opening it; see QTShortCut_ContinueTreeRead for the other steps.
+//
+//////////
+
+static void QTShortCut_StartTreeRead (QTShortCutTreeReadPtr theRead)
+{
+	HParmBlkPtr		myPB = &theRead->fParamBlock;
+	
+	theRead->fRefNum = 0;
+	
+	// an empty file needs no reading, and a file whose buffer couldn't be allocated can't be read
+	if ((theRead->fErr != noErr) || (theRead->fDataSize == 0)) {
+		theRead->fStep = kAsyncReadStepDone;
+		return;
+	}
+	
+	myPB->ioParam.ioCompletion = NULL;
+	myPB->ioParam.ioNamePtr = theRead->fFSSpec.name;
+	myPB->ioParam.ioVRefNum = theRead->fFSSpec.vRefNum;
+	myPB->fileParam.ioDirID = theRead->fFSSpec.parID;
+	myPB->ioParam.ioVersNum = 0;
+	myPB->ioParam.ioPermssn = fsRdPerm;
+	myPB->ioParam.ioMisc = NULL;
+	
+	theRead->fStep = kAsyncReadStepOpen;
+	PBHOpenDFAsync(myPB);
+}
+
+
+//////////
+//
+// QTShortCut_IndexSyncShortcut
+// Add the specified shortcut movie file to the index of a sync service, as part of a call to QTShortCut_NewSyncService.
+//
+//////////
+
+static OSErr QTShortCut_IndexSyncShortcut (FSSpecPtr theFSSpecPtr, long theSize, unsigned long theModDate, void *theRefCon)
+{
+	QTShortCutSyncServicePtr	myService = (QTShortCutSyncServicePtr)theRefCon;
+	FSSpec						myTarget;
+	Boolean						myIsAlias = false;
+	Boolean						myWasChanged = false;
+	OSErr						myErr = noErr;
+	
+	// a movie file this large is an ordinary movie, not a shortcut, so there's no point in reading it
+	if (theSize > kShortcutMaxScanSize)
+		return(noErr);
+	
+	myErr = QTShortCut_ReadSyncAlias(myService, theFSSpecPtr, &myIsAlias);
+	if ((myErr == noErr) && myIsAlias)
+		myErr = ResolveAliasWithMountFlags(theFSSpecPtr, (AliasHandle)myService->fAlias, &myTarget, &myWasChanged, kResolveAliasFileNoUI);
+	
+	// each file is visited just once, so there's no need to look for an entry for it in the index
+	if ((myErr == noErr) && myIsAlias)
+		myErr = QTShortCut_AddSyncEntry(myService, theFSSpecPtr, &myTarget, false);
+	
+	// a shortcut that can't be read or whose target can't be found doesn't stop the scan
+	if (myErr != memFullErr)
+		myErr = noErr;
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_ReadSyncAlias
+// Read the specified shortcut movie file and, if its data reference is an alias, copy the alias into the alias
+// handle of the specified sync service; the file data handle of the service is reused for reading the file. Files
+// larger than kShortcutMaxScanSize are taken not to be shortcuts, and aren't read.
+//
+//////////
+
+static OSErr QTShortCut_ReadSyncAlias (QTShortCutSyncServicePtr theService, FSSpecPtr theFSSpecPtr, Boolean *theIsAlias)
+{
+	OSType			myDataRefType;
+	Ptr				myDataRefPtr;
+	long			myDataRefSize;
+	short			myRefNum = 0;
+	long			mySize = 0;
+	OSErr			myErr = noErr;
+	
+	*theIsAlias = false;
+	
+	myErr = FSpOpenDF(theFSSpecPtr, fsRdPerm, &myRefNum);
+	if (myErr != noErr)
+		return(myErr);
+	
+	myErr = GetEOF(myRefNum, &mySize);
+	
+	// a file too large to be a shortcut isn't read (see QTShortCut_IndexSyncShortcut)
+	if ((myErr == noErr) && (mySize > kShortcutMaxScanSize)) {
+		FSClose(myRefNum);
+		return(noErr);
+	}
+	
+	if (myErr == noErr) {
+		SetHandleSize(theService->fFileData, mySize);
+		myErr = MemError();
+	}
+	
+	HLock(theService->fFileData);
+	
+	if (myErr == noErr)
+		myErr = FSRead(myRefNum, &mySize, *theService->fFileData);
+	
+	FSClose(myRefNum);
+	
+	if (myErr == noErr)
+		myErr = QTShortCut_ParseShortcutData(*theService->fFileData, mySize, &myDataRefType, &myDataRefPtr, &myDataRefSize);
+	
+	if ((myErr == noErr) && (myDataRefType == rAliasType)) {
+		SetHandleSize(theService->fAlias, myDataRefSize);
+		myErr = MemError();
+		if (myErr == noErr) {
+			BlockMoveData(myDataRefPtr, *theService->fAlias, myDataRefSize);
+			*theIsAlias = true;
+		}
+	}
+	
+	HUnlock(theService->fFileData);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_SyncShortcut
+// Look again at the target of the shortcut in the specified entry of the index of a sync service, rewriting the
+// shortcut if its target has been renamed or moved, and noting in the entry where the target is now. If the shortcut
+// is dropped from the index, theDropped is set to true, and the last entry in the index has taken its place.
+//
+//////////
+
+static OSErr QTShortCut_SyncShortcut (QTShortCutSyncServicePtr theService, long theIndex, QTShortCutSyncStatsPtr theStats, QTShortCutVolumeListPtr theVolumes, Boolean *theDropped)
+{
+	QTShortCutSyncEntryPtr		myEntries;
+	FSSpec						myShortcut;
+	FSSpec						myTarget;
+	long						myFolder;
+	long						myFlags;
+	Boolean						myIsAlias = false;
+	Boolean						myWasChanged = false;
+	OSErr						myErr = noErr;
+	
+	*theDropped = false;
+	
+	myShortcut = ((QTShortCutSyncEntryPtr)*theService->fEntries)[theIndex].fShortcut;
+	
+	myErr = QTShortCut_ReadSyncAlias(theService, &myShortcut, &myIsAlias);
+	if (myErr == memFullErr)
+		return(myErr);
+	
+	// if the shortcut is gone, or no longer holds an alias, there's nothing more to keep in sync
+	if ((myErr == fnfErr) || (myErr == dirNFErr) || (myErr == invalidAtomErr) || ((myErr == noErr) && !myIsAlias)) {
+		myEntries = (QTShortCutSyncEntryPtr)*theService->fEntries;
+		myEntries[theIndex] = myEntries[--theService->fNumEntries];
+		theStats->fNumDropped++;
+		*theDropped = true;
+		return(noErr);
+	}
+	
+	if (myErr != noErr) {
+		theStats->fNumErrors++;
+		return(noErr);
+	}
+	
+	theStats->fNumChecked++;
+	
+	myErr = ResolveAliasWithMountFlags(&myShortcut, (AliasHandle)theService->fAlias, &myTarget, &myWasChanged, kResolveAliasFileNoUI);
+	if (myErr != noErr) {
+		theStats->fNumDangling++;
+		return(noErr);
+	}
+	
+	// the Alias Manager updates the alias when it finds the target somewhere other than where the alias said it was
+	if (myWasChanged) {
+		myFlags = gWriteFlags;
+		gWriteFlags |= kShortcutWriteAtomicReplace;
+		myErr = QTShortCut_WriteShortcutData(theService->fAlias, rAliasType, &myShortcut, kShortcutFlushNone);
+		gWriteFlags = myFlags;
+		
+		if (myErr == noErr)
+			myErr = QTShortCut_RememberFile(theVolumes, &myShortcut);
+		
+		if (myErr == noErr)
+			theStats->fNumUpdated++;
+		else
+			theStats->fNumErrors++;
+	}
+	
+	myErr = QTShortCut_FindSyncFolder(theService, myTarget.vRefNum, myTarget.parID, &myFolder);
+	if (myErr == noErr) {
+		myEntries = (QTShortCutSyncEntryPtr)*theService->fEntries;
+		myEntries[theIndex].fTarget = myTarget;
+		myEntries[theIndex].fFolder = myFolder;
+	}
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_AddSyncEntry
+// Add an entry for the specified shortcut movie file and its target to the index of a sync service; if theMayExist
+// is true, the index is searched first, and an existing entry for the shortcut is replaced.
+//
+//////////
+
+static OSErr QTShortCut_AddSyncEntry (QTShortCutSyncServicePtr theService, FSSpecPtr theShortcut, FSSpecPtr theTarget, Boolean theMayExist)
+{
+	QTShortCutSyncEntry			myEntry;
+	QTShortCutSyncEntryPtr		myEntries;
+	long						myIndex;
+	OSErr						myErr = noErr;
+	
+	myEntry.fShortcut = *theShortcut;
+	myEntry.fTarget = *theTarget;
+	
+	myErr = QTShortCut_FindSyncFolder(theService, theTarget->vRefNum, theTarget->parID, &myEntry.fFolder);
+	if (myErr != noErr)
+		return(myErr);
+	
+	if (theMayExist) {
+		myEntries = (QTShortCutSyncEntryPtr)*theService->fEntries;
+		for (myIndex = 0; myIndex < theService->fNumEntries; myIndex++)
+			if (QTShortCut_IsSameFile(&myEntries[myIndex].fShortcut, theShortcut)) {
+				myEntries[myIndex] = myEntry;
+				return(noErr);
+			}
+	}
+	
+	myErr = QTShortCut_GrowArray(theService->fEntries, theService->fNumEntries + 1, sizeof(QTShortCutSyncEntry));
+	if (myErr != noErr)
+		return(myErr);
+	
+	((QTShortCutSyncEntryPtr)*theService->fEntries)[theService->fNumEntries++] = myEntry;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_FindSyncFolder
+// Find the specified folder in the list of folders polled by a sync service, adding it to the list if it isn't
+// there yet; theFolder receives its index in the list.
+//
+// Consecutive shortcuts tend to have their targets in the same folder, so the folder found last time is tried first.
+//
+//////////
+
+static OSErr QTShortCut_FindSyncFolder (QTShortCutSyncServicePtr theService, short theVRefNum, long theDirID, long *theFolder)
+{
+	QTShortCutSyncFolderPtr		myFolders = (QTShortCutSyncFolderPtr)*theService->fFolders;
+	QTShortCutSyncFolder		myFolder;
+	long						myIndex;
+	OSErr						myErr = noErr;
+	
+	myIndex = theService->fLastFolder;
+	if ((myIndex < theService->fNumFolders) && (myFolders[myIndex].fVRefNum == theVRefNum) && (myFolders[myIndex].fDirID == theDirID)) {
+		*theFolder = myIndex;
+		return(noErr);
+	}
+	
+	for (myIndex = 0; myIndex < theService->fNumFolders; myIndex++)
+		if ((myFolders[myIndex].fVRefNum == theVRefNum) && (myFolders[myIndex].fDirID == theDirID)) {
+			theService->fLastFolder = myIndex;
+			*theFolder = myIndex;
+			return(noErr);
+		}
+	
+	QTShortCut_GetSyncFolderState(theVRefNum, theDirID, &myFolder);
+	
+	myErr = QTShortCut_GrowArray(theService->fFolders, theService->fNumFolders + 1, sizeof(QTShortCutSyncFolder));
+	if (myErr != noErr)
+		return(myErr);
+	
+	((QTShortCutSyncFolderPtr)*theService->fFolders)[theService->fNumFolders] = myFolder;
+	theService->fLastFolder = theService->fNumFolders;
+	*theFolder = theService->fNumFolders++;
+	
+	return(noErr);
+}
+
+
+//////////
+//
+// QTShortCut_GetSyncFolderState
+// Get the parent folder, name, and modification date of the specified folder; if the folder can't be found
+// (for instance, because it has been deleted, or its volume has been unmounted), they're all set to zero.
+//
+//////////
+
+static void QTShortCut_GetSyncFolderState (short theVRefNum, long theDirID, QTShortCutSyncFolderPtr theFolder)
+{
+	CInfoPBRec			myPB;
+	
+	theFolder->fVRefNum = theVRefNum;
+	theFolder->fDirID = theDirID;
+	theFolder->fChanged = false;
+	
+	myPB.dirInfo.ioCompletion = NULL;
+	myPB.dirInfo.ioNamePtr = theFolder->fName;
+	myPB.dirInfo.ioVRefNum = theVRefNum;
+	myPB.dirInfo.ioFDirIndex = -1;
+	myPB.dirInfo.ioDrDirID = theDirID;
+	
+	if (PBGetCatInfoSync(&myPB) == noErr) {
+		theFolder->fParID = myPB.dirInfo.ioDrParID;
+		theFolder->fModDate = myPB.dirInfo.ioDrMdDat;
+	} else {
+		theFolder->fParID = 0L;
+		theFolder->fModDate = 0L;
+		theFolder->fName[0] = 0;
+	}
+}
+
+
+//////////
+//
+// QTShortCut_CheckAliasTarget
+// Look up the target of the specified alias, which was read from the specified shortcut movie file, as part of a call
+// to QTShortCut_ValidateShortcutFolder; the alias is copied into theAlias, which is reused for every shortcut. The
+// function result is noErr if the target was found.
+//
+//////////
+
+static OSErr QTShortCut_CheckAliasTarget (FSSpecPtr theFSSpecPtr, Handle theAlias, Ptr theDataRefPtr, long theDataRefSize)
+{
+	FSSpec			myTarget;
+	Boolean			myWasChanged = false;
+	OSErr			myErr = noErr;
+	
+	SetHandleSize(theAlias, theDataRefSize);
+	myErr = MemError();
+	if (myErr != noErr)
+		return(myErr);
+	
+	BlockMoveData(theDataRefPtr, *theAlias, theDataRefSize);
+	
+	return(ResolveAliasWithMountFlags(theFSSpecPtr, (AliasHandle)theAlias, &myTarget, &myWasChanged, kResolveAliasFileNoUI));
+}
+
+
+#endif	// TARGET_OS_MAC	
+
+
+#if BENCHMARKING_SHORTCUTS
+
+//////////
+//
+// QTShortCut_RunBenchmarks
+// Time the main operations on shortcut files, for data references from 16 bytes to 64 kilobytes long, and append
+// the results to the specified handle, one line of text per measurement, with tab-separated fields:
+//
+//		operation, volume, data reference size, number of threads, number of operations, total microseconds
+//
+// The operations are: "assemble" (filling in the atom headers, as the pre-4.0 writer does), "parse" (finding the
+// data reference in a shortcut held in memory), "write" (creating theCount shortcut files in a batch, with 1, 2, 4
+// and 8 worker threads), and "resolve" (resolving a shortcut file that's already in the cache). The files are written
+// into the "fast" folder (a RAM disk, say) and then into the "disk" folder, and are deleted afterwards; a folder
+// whose volume reference number is 0 is skipped.
+//
+// The results are meant to be saved by the test shell and compared from one build to the next.
+//
+//////////
+
+OSErr QTShortCut_RunBenchmarks (short theFastVRefNum, long theFastDirID, short theDiskVRefNum, long theDiskDirID, long theCount, Handle theResults)
+{
+	FSSpec *		myFSSpecs = NULL;
+	Handle *		myDataRefs = NULL;
+	OSType *		myDataRefTypes = NULL;
+	OSErr *			myErrors = NULL;
+	Handle			myDataRef = NULL;
+	Handle			myResolved = NULL;
+	Ptr				myShortcut = NULL;
+	unsigned char	myHeader[kShortcutHeaderSize];
+	OSType			myDataRefType;
+	Ptr				myDataRefPtr;
+	long			myDataRefSize;
+	long			mySize;
+	long			myIndex;
+	short			myVolume;
+	double			myStart;
+	Str255			myName;
+	OSErr			myErr = noErr;
+	
+	if ((theResults == NULL) || (theCount <= 0))
+		return(paramErr);
+	
+	myFSSpecs = (FSSpec *)NewPtrClear(theCount * sizeof(FSSpec));
+	myDataRefs = (Handle *)NewPtrClear(theCount * sizeof(Handle));
+	myDataRefTypes = (OSType *)NewPtrClear(theCount * sizeof(OSType));
+	myErrors = (OSErr *)NewPtrClear(theCount * sizeof(OSErr));
+	myResolved = NewHandle(0);
+	if ((myFSSpecs == NULL) || (myDataRefs == NULL) || (myDataRefTypes == NULL) || (myErrors == NULL) || (myResolved == NULL)) {
+		myErr = memFullErr;
+		goto bail;
+	}
+	
+	for (mySize = 16; (mySize <= 64 * 1024L) && (myErr == noErr); mySize *= 4) {
+		// every shortcut in the batch refers to the same data reference, of the current size
+		myDataRef = NewHandle(mySize);
+		myShortcut = NewPtr(kShortcutHeaderSize + mySize);
+		if ((myDataRef == NULL) || (myShortcut == NULL)) {
+			myErr = memFullErr;
+			goto bail;
+		}
+		
+		for (myIndex = 0; myIndex < mySize; myIndex++)
+			(*myDataRef)[myIndex] = 'a' + (myIndex % 26);
+		
+		for (myIndex = 0; myIndex < theCount; myIndex++) {
+			myDataRefs[myIndex] = myDataRef;
+			myDataRefTypes[myIndex] = URLDataHandlerSubType;
+		}
+		
+		// assembling the atom headers
+		myStart = QTShortCut_GetMicroseconds();
+		for (myIndex = 0; myIndex < theCount; myIndex++)
+			QTShortCut_FillShortcutHeader(mySize + (myIndex & 1), URLDataHandlerSubType, (Ptr)myHeader);
+		myErr = QTShortCut_AddBenchmarkResult(theResults, "assemble", "memory", mySize, 1, theCount, QTShortCut_GetMicroseconds() - myStart);
+		
+		// parsing a shortcut in memory
+		QTShortCut_FillShortcutHeader(mySize, URLDataHandlerSubType, (Ptr)myHeader);
+		BlockMoveData(myHeader, myShortcut, kShortcutHeaderSize);
+		BlockMoveData(*myDataRef, myShortcut + kShortcutHeaderSize, mySize);
+		
+		myStart = QTShortCut_GetMicroseconds();
+		for (myIndex = 0; (myIndex < theCount) && (myErr == noErr); myIndex++)
+			myErr = QTShortCut_ParseShortcutData(myShortcut, kShortcutHeaderSize + mySize, &myDataRefType, &myDataRefPtr, &myDataRefSize);
+		if (myErr == noErr)
+			myErr = QTShortCut_AddBenchmarkResult(theResults, "parse", "memory", mySize, 1, theCount, QTShortCut_GetMicroseconds() - myStart);
+		
+		// writing and resolving files, on each volume
+		for (myVolume = 0; (myVolume < 2) && (myErr == noErr); myVolume++) {
+			short		myVRefNum = (myVolume == 0) ? theFastVRefNum : theDiskVRefNum;
+			long		myDirID = (myVolume == 0) ? theFastDirID : theDiskDirID;
+			
+			if (myVRefNum == 0)
+				continue;
+			
+			for (myIndex = 0; myIndex < theCount; myIndex++) {
+				NumToString(myIndex, myName);
+				myName[0] += 4;
+				BlockMoveData(&myName[1], &myName[5], myName[0] - 4);
+				BlockMoveData("qtsb", &myName[1], 4);
+				
+				myErr = FSMakeFSSpec(myVRefNum, myDirID, myName, &myFSSpecs[myIndex]);
+				if (myErr == fnfErr)
+					myErr = noErr;
+				if (myErr != noErr)
+					goto bail;
+			}
+			
+			myErr = QTShortCut_BenchmarkWrites((myVolume == 0) ? "fast" : "disk", myFSSpecs, myDataRefs, myDataRefTypes, myErrors, theCount, mySize, theResults);
+			
+			if (myErr == noErr) {
+				myErr = QTShortCut_ResolveShortcutMovieFile(&myFSSpecs[0], &myDataRefType, myResolved);
+				
+				myStart = QTShortCut_GetMicroseconds();
+				for (myIndex = 0; (myIndex < theCount) && (myErr == noErr); myIndex++)
+					myErr = QTShortCut_ResolveShortcutMovieFile(&myFSSpecs[0], &myDataRefType, myResolved);
+				if (myErr == noErr)
+					myErr = QTShortCut_AddBenchmarkResult(theResults, "resolve", (myVolume == 0) ? "fast" : "disk", mySize, 1, theCount, QTShortCut_GetMicroseconds() - myStart);
+			}
+			
+			for (myIndex = 0; myIndex < theCount; myIndex++)
+				FSpDelete(&myFSSpecs[myIndex]);
+			QTShortCut_InvalidateShortcutCache(NULL);
+		}
+		
+		DisposeHandle(myDataRef);
+		myDataRef = NULL;
+		DisposePtr(myShortcut);
+		myShortcut = NULL;
+	}
+
+bail:
+	if (myDataRef != NULL)
+		DisposeHandle(myDataRef);
+	if (myShortcut != NULL)
+		DisposePtr(myShortcut);
+	if (myResolved != NULL)
+		DisposeHandle(myResolved);
+	if (myFSSpecs != NULL)
+		DisposePtr((Ptr)myFSSpecs);
+	if (myDataRefs != NULL)
+		DisposePtr((Ptr)myDataRefs);
+	if (myDataRefTypes != NULL)
+		DisposePtr((Ptr)myDataRefTypes);
+	if (myErrors != NULL)
+		DisposePtr((Ptr)myErrors);
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_BenchmarkWrites
+// Time writing the specified batch of shortcut files with 1, 2, 4 and 8 worker threads.
+//
+//////////
+
+static OSErr QTShortCut_BenchmarkWrites (char *theVolumeName, FSSpec theFSSpecs[], Handle theDataRefs[], OSType theDataRefTypes[], OSErr theErrors[], long theCount, long theSize, Handle theResults)
+{
+	short			myNumThreads;
+	long			myIndex;
+	double			myStart;
+	OSErr			myErr = noErr;
+	
+	for (myNumThreads = 1; (myNumThreads <= 8) && (myErr == noErr); myNumThreads *= 2) {
+		// start each run with none of the batch's files in place, so that no run pays for replacing the files of
+		// the run before it, and every row measures the same work
+		for (myIndex = 0; myIndex < theCount; myIndex++)
+			FSpDelete(&theFSSpecs[myIndex]);
+		
+		// the single-threaded baseline goes through the same writer as the others, so that only the thread count differs
+		myStart = QTShortCut_GetMicroseconds();
+		myErr = QTShortCut_CreateShortcutMovieFilesInParallel(theDataRefs, theDataRefTypes, theFSSpecs, theCount, myNumThreads, theErrors);
+		
+		if (myErr == noErr)
+			myErr = QTShortCut_AddBenchmarkResult(theResults, "write", theVolumeName, theSize, myNumThreads, theCount, QTShortCut_GetMicroseconds() - myStart);
+	}
+	
+	return(myErr);
+}
+
+
+//////////
+//
+// QTShortCut_AddBenchmarkResult
+// Append a line describing a measurement to the specified handle.
+//
+//////////
+
+static OSErr QTShortCut_AddBenchmarkResult (Handle theResults, char *theName, char *theVolumeName, long theSize, short theNumThreads, long theCount, double theMicroseconds)
+{
+	char			myLine[256];
+	
+	sprintf(myLine, "%s\t%s\t%ld\t%d\t%ld\t%.0f\n", theName, theVolumeName, theSize, theNumThreads, theCount, theMicroseconds);
+	
+	return(PtrAndHand(myLine, theResults, strlen(myLine)));
+}
+
+
+//////////
+//
+// QTShortCut_GetMicroseconds
+// Get the number of microseconds since the machine was started.
+//
+//////////
+
+static double QTShortCut_GetMicroseconds (void)
+{
+	UnsignedWide	myTime;
+	
+	Microseconds(&myTime);
+	
+	return(((double)myTime.hi * 4294967296.0) + (double)myTime.lo);
+}
+
+
+#endif	// BENCHMARKING_SHORTCUTS
+
 
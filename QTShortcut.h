@@ -16,6 +16,10 @@
 
 #include <Movies.h>
 #include <Script.h>
+#if TARGET_OS_MAC
+#include <Aliases.h>
+#include <Threads.h>
+#endif
 #include "QTUtilities.h"
 
 
@@ -26,6 +30,12 @@
 //////////
 
 #define TESTING_SHORTCUTS		1			// compiler flag for our test shell
+#ifndef BENCHMARKING_SHORTCUTS
+#define BENCHMARKING_SHORTCUTS	0			// compiler flag for QTShortCut_RunBenchmarks
+#endif
+#ifndef POSIX_SHORTCUTS
+#define POSIX_SHORTCUTS			0			// compiler flag for the POSIX file functions (QTShortCut_CreateShortcutMovieFileAtPath and friends)
+#endif
 
 
 //////////
@@ -38,6 +48,240 @@
 #define kShortcutFileType		MovieFileType
 #define kShortcutFileCreator	FOUR_CHAR_CODE('TVOD')
 
+// size of the 32-bit fields (atom sizes and types, offsets, counts) in shortcut files and shortcut packs; these
+// are always 4 bytes, even where a long is larger
+#define kShortcutFieldSize		4
+
+// size of the atom headers and data reference type that precede the data reference in a shortcut file
+#define kShortcutHeaderSize		((3 * 2 * kShortcutFieldSize) + kShortcutFieldSize)
+
+// the same, when the atoms have extended (64-bit) sizes; these are used only when a size doesn't fit in 32 bits
+#define kShortcutExtendedHeaderSize	((3 * 4 * kShortcutFieldSize) + kShortcutFieldSize)
+
+// largest file that can be assembled in memory, and so largest data reference that can be given in a handle
+#define kShortcutMaxFileSize	0x7FFFFFFFL
+
+// type of a shortcut pack file, the tag at the start of its header, and the version of its format
+#define kShortcutPackFileType	FOUR_CHAR_CODE('SCpk')
+#define kShortcutPackMagic		FOUR_CHAR_CODE('qtsp')
+#define kShortcutPackVersion	1
+
+// maximum number of distinct volumes whose flushing is deferred to the end of a batch
+#define kShortcutMaxBatchVolumes	16
+
+// ways of creating shortcut files, for QTShortCut_SetShortcutWriter
+enum {
+	kShortcutWriterAuto			= 0,			// use CreateShortcutMovieFile if QuickTime 4.0 or greater is present
+	kShortcutWriterToolbox		= 1,			// always use CreateShortcutMovieFile
+	kShortcutWriterManual		= 2				// always assemble the shortcut file ourselves
+};
+
+// flags for QTShortCut_SetWriteFlags
+enum {
+	kShortcutWriteAtomicReplace	= 1L << 0,		// write to a temporary file and then move it into place
+	kShortcutWriteDedupTargets	= 1L << 1		// in a batch, write repeated targets from the first copy
+};
+
+// policies for QTShortCut_SetBatchFlushPolicy, from the least strict to the most strict
+enum {
+	kShortcutFlushNone			= 0,			// never flush files or volumes
+	kShortcutFlushAtEndOfBatch	= 1,			// flush each volume once, when the batch is done
+	kShortcutFlushPerFolder		= 2,			// flush each time the batch moves on to a different folder
+	kShortcutFlushPerFile		= 3,			// flush each file before it is closed
+	kShortcutFlushVolumePerFile	= 4				// flush the volume after each file is written
+};
+
+// the steps in creating a shortcut file whose times are recorded when instrumentation is on (see QTShortCut_SetInstrumentation)
+enum {
+	kShortcutPhaseAssemble		= 0,			// filling in the atom headers
+	kShortcutPhaseToolbox,						// CreateShortcutMovieFile, as a whole
+	kShortcutPhaseDelete,						// FSpDelete
+	kShortcutPhaseCreate,						// FSpCreate
+	kShortcutPhaseOpen,							// FSpOpenDF
+	kShortcutPhaseWrite,						// SetFPos and FSWrite
+	kShortcutPhaseTruncate,						// SetFPos and SetEOF
+	kShortcutPhaseFlushFile,					// PBFlushFile
+	kShortcutPhaseClose,						// FSClose
+	kShortcutPhaseReplace,						// moving a temporary file into place
+	kShortcutPhaseFlushVolume,					// FlushVol
+	kShortcutNumPhases
+};
+
+// maximum number of worker threads used by QTShortCut_CreateShortcutMovieFilesInParallel
+#define kShortcutMaxWorkers		32
+
+// maximum number of files that QTShortCut_CreateShortcutMovieFilesAsync writes at once
+#define kShortcutMaxWritesInFlight	256
+
+// maximum number of files that QTShortCut_IndexShortcutFolder reads at once
+#define kShortcutMaxReadsInFlight	256
+
+// largest movie file read when a folder of shortcuts is scanned; larger movie files are taken not to be shortcuts
+#define kShortcutMaxScanSize	65536L
+
+// what QTShortCut_ValidateShortcutFolder found wrong with a shortcut movie file
+enum {
+	kShortcutValid				= 0,			// laid out just as QTShortCut_CreateShortcutMovieFile writes it
+	kShortcutMalformed			= 1,			// atoms of the wrong types, wrongly nested, or holding a malformed data reference
+	kShortcutTruncated			= 2,			// atoms that extend past the end of the file
+	kShortcutUnknownType		= 3,			// a data reference that's neither an alias nor a URL
+	kShortcutDangling			= 4,			// an alias whose target can't be found
+	kShortcutUnreadable			= 5,			// a file that couldn't be read
+	kShortcutNotShortcut		= 6				// an ordinary movie, which is skipped rather than reported
+};
+
+// number of resolved shortcuts remembered by QTShortCut_ResolveShortcutMovieFile
+#define kShortcutCacheSize		64
+
+// formats of a manifest read by QTShortCut_CreateShortcutsFromManifest
+enum {
+	kShortcutManifestLines		= 0,			// one file per line: name, tab, data reference type, tab, data reference
+	kShortcutManifestBinary		= 1				// length-prefixed records (see QTShortCut_CreateShortcutsFromManifest)
+};
+
+// number of manifest records written at a time, and the largest manifest record that can be read
+#define kShortcutManifestBatchSize	256
+#define kShortcutManifestBufferSize	32768
+
+// size of the pieces in which QTShortCut_CreateShortcutMovieFileFromStream copies a data reference
+#define kShortcutStreamBufferSize	32768
+
+// maximum number of Gestalt responses and components that a client can describe to QTShortCut_SelectRefMovieTarget
+#define kShortcutMaxClientChecks	8
+
+
+//////////
+//
+// data types
+//
+//////////
+
+// one target of a reference movie created by QTShortCut_CreateReferenceMovieFile, along with the conditions under
+// which QuickTime should choose it; a zero in a qualifier's first field means that the qualifier is omitted
+typedef struct {
+	Handle							fDataRef;						// the target itself
+	OSType							fDataRefType;
+	long							fDataRate;						// minimum connection speed, in bytes per second
+	short							fCPUSpeed;						// minimum CPU speed rating
+	OSType							fGestaltSelector;				// version check: Gestalt selector,
+	long							fGestaltValue1;					//   the values to check its response against,
+	long							fGestaltValue2;
+	short							fGestaltCheckType;				//   and how to check it (for example, kVersionCheckMin)
+	ComponentDescription			fComponentDesc;					// a component that must be present (componentType != 0),
+	long							fComponentMinVersion;			//   and its minimum version
+	long							fQuality;						// preference among otherwise equal targets
+} QTShortCutRefMovieTarget, *QTShortCutRefMovieTargetPtr;
+
+// what a client can do, for choosing among the targets of a reference movie with QTShortCut_SelectRefMovieTarget
+typedef struct {
+	long							fDataRate;						// connection speed, in bytes per second
+	short							fCPUSpeed;						// CPU speed rating
+	short							fNumGestalts;					// the client's responses to some Gestalt selectors
+	OSType							fGestaltSelectors[kShortcutMaxClientChecks];
+	long							fGestaltResponses[kShortcutMaxClientChecks];
+	short							fNumComponents;					// the components installed on the client, and their versions
+	ComponentDescription			fComponentDescs[kShortcutMaxClientChecks];
+	long							fComponentVersions[kShortcutMaxClientChecks];
+} QTShortCutClientInfo, *QTShortCutClientInfoPtr;
+
+// a rule for QTShortCut_RetargetShortcuts: data references of the specified type (or of any type, if it's 0)
+// that begin with the old prefix get the new prefix instead
+typedef struct {
+	OSType							fDataRefType;
+	Ptr								fOldPrefix;
+	long							fOldPrefixSize;
+	Ptr								fNewPrefix;
+	long							fNewPrefixSize;
+} QTShortCutRetargetRule, *QTShortCutRetargetRulePtr;
+
+// what QTShortCut_RetargetShortcuts did
+typedef struct {
+	long							fNumScanned;					// shortcut movie files looked at
+	long							fNumSkipped;					// movie files that aren't shortcuts
+	long							fNumChanged;					// shortcuts given a new target,
+	long							fNumInPlace;					//   by patching the data reference in place
+	long							fNumReplaced;					//   or by replacing the file atomically
+	long							fNumErrors;						// shortcuts that couldn't be read or rewritten
+	unsigned long					fTicks;							// how long it all took, in ticks
+} QTShortCutRetargetStats, *QTShortCutRetargetStatsPtr;
+
+// what QTShortCut_CreateShortcutsFromManifest did
+typedef struct {
+	long							fNumRecords;					// records read from the manifest
+	long							fNumCreated;					// shortcut movie files written
+	long							fNumMalformed;					// records that couldn't be parsed
+	long							fNumErrors;						// records too large to read, or whose files couldn't be written
+	unsigned long					fTicks;							// how long it all took, in ticks
+} QTShortCutManifestStats, *QTShortCutManifestStatsPtr;
+
+// what a call to QTShortCut_IdleSyncService did
+typedef struct {
+	long							fNumShortcuts;					// shortcuts in the index, after the call
+	long							fNumFolders;					// folders polled for changes
+	long							fNumChangedFolders;				// folders that had changed since the last call
+	long							fNumChecked;					// shortcuts whose targets were looked up again
+	long							fNumUpdated;					// shortcuts rewritten because their targets had moved
+	long							fNumDangling;					// shortcuts whose targets couldn't be found
+	long							fNumDropped;					// shortcuts deleted, or no longer holding aliases
+	long							fNumErrors;						// shortcuts that couldn't be read or rewritten
+	unsigned long					fTicks;							// how long it all took, in ticks
+} QTShortCutSyncStats, *QTShortCutSyncStatsPtr;
+
+// what QTShortCut_IndexShortcutFolder did
+typedef struct {
+	long							fNumScanned;					// movie files found
+	long							fNumUnchanged;					// files already indexed, and not changed since
+	long							fNumRead;						// files read,
+	long							fNumIndexed;					//   that were shortcuts and were added to the index
+	long							fNumSkipped;					//   or that weren't shortcuts
+	long							fNumErrors;						// files that couldn't be read
+	long							fNumEntries;					// shortcuts in the index, after the call
+	unsigned long					fTicks;							// how long it all took, in ticks
+} QTShortCutIndexStats, *QTShortCutIndexStatsPtr;
+
+// what QTShortCut_ValidateShortcutFolder found; the throughput is fNumScanned files, and fNumBytes bytes, in fTicks ticks
+typedef struct {
+	long							fNumScanned;					// movie files found
+	long							fNumSkipped;					// ordinary movies, which aren't shortcuts
+	long							fNumValid;						// shortcuts that passed every check
+	long							fNumMalformed;					// files with each of the problems listed above
+	long							fNumTruncated;
+	long							fNumUnknownType;
+	long							fNumDangling;
+	long							fNumErrors;						// files that couldn't be read
+	UnsignedWide					fNumBytes;						// bytes read
+	unsigned long					fTicks;							// how long it all took, in ticks
+} QTShortCutValidateStats, *QTShortCutValidateStatsPtr;
+
+// a function that supplies the next part of a manifest, in the manner of FSRead: on entry, theSize is the number
+// of bytes wanted, and on exit it's the number read; the result is eofErr once the end of the manifest is reached
+typedef OSErr (*QTShortCutReadProcPtr) (Ptr theBuffer, long *theSize, void *theRefCon);
+
+// a function called by QTShortCut_ValidateShortcutFolder for each shortcut movie file that has a problem (one of the
+// kShortcut values above); theErr is the error the file couldn't be read with, or its target couldn't be found with
+typedef OSErr (*QTShortCutValidateProcPtr) (FSSpecPtr theFSSpecPtr, short theProblem, OSErr theErr, void *theRefCon);
+
+// the times recorded for one step in creating shortcut files, in microseconds
+typedef struct {
+	unsigned long					fCount;							// how many times the step was taken
+	double							fTotal;
+	unsigned long					fMax;
+	unsigned long					fP50;							// the median, and the 99th percentile (these are upper
+	unsigned long					fP99;							//   bounds, accurate to within a factor of two)
+} QTShortCutPhaseStats, *QTShortCutPhaseStatsPtr;
+
+// the targets of a reference movie, prepared by QTShortCut_NewRefMovieTable for quick selection
+typedef struct QTShortCutRefMovieTable *QTShortCutRefMovieTablePtr;
+
+// a folder that files are written into by name, prepared by QTShortCut_NewOutputContext
+typedef struct QTShortCutOutputContext *QTShortCutOutputContextPtr;
+
+// the reverse index from targets to shortcuts kept by a sync service, created by QTShortCut_NewSyncService
+typedef struct QTShortCutSyncService *QTShortCutSyncServicePtr;
+
+// a reverse index from targets to the shortcuts that refer to them, created by QTShortCut_NewShortcutIndex
+typedef struct QTShortCutIndex *QTShortCutIndexPtr;
+
 
 //////////
 //
@@ -46,4 +290,56 @@
 //////////
 
 OSErr							QTShortCut_CreateShortcutMovieFile (Handle theDataRef, OSType theDataRefType, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_CreateShortcutMovieFiles (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, OSErr theErrors[]);
+OSErr							QTShortCut_CreateShortcutMovieFilesInParallel (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, short theNumWorkers, OSErr theErrors[]);
+OSErr							QTShortCut_CreateShortcutMovieFilesAsync (Handle theDataRefs[], OSType theDataRefTypes[], FSSpec theFSSpecs[], long theCount, short theMaxInFlight, OSErr theErrors[]);
+OSErr							QTShortCut_CreateShortcutMovieFileFromStream (QTShortCutReadProcPtr theReadProc, void *theRefCon, UnsignedWide theDataRefSize, OSType theDataRefType, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_CreateReferenceMovieFile (QTShortCutRefMovieTarget theTargets[], short theNumTargets, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_NewRefMovieTable (Ptr theData, long theSize, QTShortCutRefMovieTablePtr *theTable);
+void							QTShortCut_DisposeRefMovieTable (QTShortCutRefMovieTablePtr theTable);
+OSErr							QTShortCut_SelectRefMovieTarget (QTShortCutRefMovieTablePtr theTable, QTShortCutClientInfoPtr theClient, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize);
+void							QTShortCut_SetShortcutWriter (short theWriter);
+short							QTShortCut_GetShortcutWriter (void);
+void							QTShortCut_SetInstrumentation (Boolean theEnabled);
+void							QTShortCut_GetPhaseStats (short thePhase, QTShortCutPhaseStatsPtr theStats);
+void							QTShortCut_ResetPhaseStats (void);
+void							QTShortCut_SetWriteFlags (long theFlags);
+long							QTShortCut_GetWriteFlags (void);
+void							QTShortCut_SetBatchFlushPolicy (short thePolicy);
+short							QTShortCut_GetBatchFlushPolicy (void);
 OSErr							QTShortCut_WriteHandleToFile (Handle theHandle, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_NewOutputContext (short theVRefNum, long theDirID, QTShortCutOutputContextPtr *theContext);
+OSErr							QTShortCut_CreateShortcutInContext (QTShortCutOutputContextPtr theContext, Handle theDataRef, OSType theDataRefType, ConstStr255Param theName);
+OSErr							QTShortCut_WriteHandleInContext (QTShortCutOutputContextPtr theContext, Handle theHandle, ConstStr255Param theName);
+OSErr							QTShortCut_FlushOutputContext (QTShortCutOutputContextPtr theContext);
+void							QTShortCut_DisposeOutputContext (QTShortCutOutputContextPtr theContext);
+OSErr							QTShortCut_ParseShortcutData (Ptr theData, long theSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize);
+OSErr							QTShortCut_ReadShortcutMovieFile (FSSpecPtr theFSSpecPtr, Ptr theBuffer, long theBufferSize, OSType *theDataRefType, Ptr *theDataRefPtr, long *theDataRefSize);
+OSErr							QTShortCut_ResolveShortcutMovieFile (FSSpecPtr theFSSpecPtr, OSType *theDataRefType, Handle theDataRef);
+void							QTShortCut_InvalidateShortcutCache (FSSpecPtr theFSSpecPtr);
+void							QTShortCut_ReleaseScratchMemory (void);
+OSErr							QTShortCut_CreateShortcutPackFile (Handle theDataRefs[], OSType theDataRefTypes[], StringPtr theNames[], long theCount, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_FindInShortcutPack (Ptr thePack, long thePackSize, ConstStr255Param theName, Ptr *theShortcutPtr, long *theShortcutSize);
+OSErr							QTShortCut_ExtractShortcutPack (Ptr thePack, long thePackSize, short theVRefNum, long theDirID, long *theNumExtracted);
+OSErr							QTShortCut_RetargetShortcuts (short theVRefNum, long theDirID, QTShortCutRetargetRule theRules[], short theNumRules, QTShortCutRetargetStatsPtr theStats);
+OSErr							QTShortCut_CreateShortcutsFromManifest (QTShortCutReadProcPtr theReadProc, void *theRefCon, short theFormat, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutManifestStatsPtr theStats);
+OSErr							QTShortCut_CreateShortcutsFromManifestFile (FSSpecPtr theManifestFSSpecPtr, short theFormat, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutManifestStatsPtr theStats);
+OSErr							QTShortCut_NewSyncService (short theVRefNum, long theDirID, QTShortCutSyncServicePtr *theService);
+OSErr							QTShortCut_AddToSyncService (QTShortCutSyncServicePtr theService, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_IdleSyncService (QTShortCutSyncServicePtr theService, QTShortCutSyncStatsPtr theStats);
+void							QTShortCut_DisposeSyncService (QTShortCutSyncServicePtr theService);
+OSErr							QTShortCut_NewShortcutIndex (QTShortCutIndexPtr *theIndex);
+OSErr							QTShortCut_IndexShortcutFolder (QTShortCutIndexPtr theIndex, short theVRefNum, long theDirID, short theMaxInFlight, QTShortCutIndexStatsPtr theStats);
+OSErr							QTShortCut_UpdateShortcutIndex (QTShortCutIndexPtr theIndex, FSSpecPtr theFSSpecPtr);
+OSErr							QTShortCut_FindInShortcutIndex (QTShortCutIndexPtr theIndex, OSType theDataRefType, Ptr thePrefix, long thePrefixSize, FSSpec theFSSpecs[], long theMaxCount, long *theCount);
+void							QTShortCut_DisposeShortcutIndex (QTShortCutIndexPtr theIndex);
+OSErr							QTShortCut_ValidateShortcutFolder (short theVRefNum, long theDirID, short theMaxInFlight, Boolean theCheckTargets, QTShortCutValidateProcPtr theProc, void *theRefCon, QTShortCutValidateStatsPtr theStats);
+#if POSIX_SHORTCUTS
+OSErr							QTShortCut_CreateShortcutMovieFileAtPath (Handle theDataRef, OSType theDataRefType, const char *thePath);
+OSErr							QTShortCut_CreateShortcutMovieFilesAtPaths (Handle theDataRefs[], OSType theDataRefTypes[], const char *thePaths[], long theCount, OSErr theErrors[]);
+OSErr							QTShortCut_WriteHandleToPath (Handle theHandle, const char *thePath);
+OSErr							QTShortCut_NewOutputContextForPath (const char *theDirPath, QTShortCutOutputContextPtr *theContext);
+#endif
+#if BENCHMARKING_SHORTCUTS
+OSErr							QTShortCut_RunBenchmarks (short theFastVRefNum, long theFastDirID, short theDiskVRefNum, long theDiskDirID, long theCount, Handle theResults);
+#endif